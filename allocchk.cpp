@@ -0,0 +1,174 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// a separate program (built by bld.sh as allocchk), that checks that
+// the look-ahead does not allocate from the heap at the positions it
+// examines, even when promoting pawns.  it replaces operator new with
+// a version that counts its calls, which is why it is not part of the
+// chess program.  the command line is "allocchk [look-ahead]", and the
+// exit status is 1 if the check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+#include "misc.hpp"
+#include "brdsize.hpp"
+#include "chess.hpp"
+#include "cplayer.hpp"
+#include "thrdpool.hpp"
+
+// position with pawns of both colors about to promote, where the
+// look-ahead promotes at many of the positions it examines
+LOCAL const char promoteFen[] = "8/PPP4k/8/8/8/8/4Kppp/8 w - - 0 1";
+
+// number of threads for the checks of the look-ahead split among
+// threads
+const int SPLITTHREADS = 4;
+
+// number of calls of operator new.  the replacements of operator new
+// and delete only add the counting.
+LOCAL std::atomic<unsigned long long> nNews;
+
+void *operator new(size_t size)
+  {
+    void *p = malloc(size ? size : 1);
+
+    if (!p)
+      throw std::bad_alloc();
+
+    nNews++;
+
+    return(p);
+  }
+
+void operator delete(void *p) noexcept
+  {
+    free(p);
+
+    return;
+  }
+
+void operator delete(void *p, size_t) noexcept
+  {
+    free(p);
+
+    return;
+  }
+
+// used by the rest of the program when new returns null, which the
+// replacement above never does
+void OutOfMemory(void)
+  {
+    fprintf(stderr, "allocchk: out of memory\n");
+    exit(1);
+  }
+
+// number of heap allocations made by looking ahead from the position,
+// by findBestMoves if player is null, otherwise by the player's
+// chooseMove
+LOCAL unsigned long long countNews
+  (
+    int lookAhead,
+    const COMPUTERPLAYER *player
+  )
+  {
+    BOARD board;
+    BOARDMETRIC metric;
+    BESTMOVES bestMoves;
+    PIECEMOVE move;
+    PIECECOLOR color;
+    unsigned long long news;
+
+    if (!board.readFen(promoteFen, color))
+      {
+        fprintf(stderr, "allocchk: bad position %s\n", promoteFen);
+        exit(1);
+      }
+
+    news = nNews;
+    if (player)
+      player->chooseMove(board, move);
+    else
+      board.findBestMoves(lookAhead, color, metric, &bestMoves, TRUE);
+
+    return(nNews - news);
+  }
+
+// print the result of a check, and return whether it passed
+LOCAL BOOL check
+  (
+    const char *what,
+    unsigned long long news,
+    unsigned long long expected
+  )
+  {
+    printf("%-40s %6llu heap allocations\n", what, news);
+    if (news == expected)
+      return(TRUE);
+
+    fprintf(stderr, "allocchk: %s: %llu expected\n", what, expected);
+    return(FALSE);
+  }
+
+int main(int nArg, char **arg)
+  {
+    long lookAhead = 4;
+    char *end;
+    BOOL ok = TRUE;
+    unsigned long long perSplit;
+
+    if (nArg > 2)
+      exit(1);
+    if (nArg == 2)
+      {
+        lookAhead = strtol(arg[1], &end, 10);
+        if ((end == arg[1]) || *end || (lookAhead < 2) ||
+            (lookAhead > MAXLOOKAHEAD))
+          exit(1);
+      }
+
+    COMPUTERPLAYER player(WHITE, (int) lookAhead);
+
+    // with one thread, nothing at all may be allocated, including by
+    // the choice among the best moves, and by each deeper look-ahead
+    // of chooseMove
+    SearchThreads.setThreads(1);
+    ok &= check("look-ahead, one thread",
+                countNews((int) lookAhead, (COMPUTERPLAYER *) 0), 0);
+    ok &= check("choosing a move, one thread",
+                countNews((int) lookAhead, &player), 0);
+
+    // when the first moves are split among threads, each look-ahead
+    // allocates the state shared by the threads, and each thread copies
+    // the board.  that must be all, so a deeper look-ahead must not
+    // allocate more than the shortest one, and chooseMove, which
+    // deepens the look-ahead one move at a time from 2, must allocate
+    // that much for each look-ahead.
+    SearchThreads.setThreads(SPLITTHREADS);
+    perSplit = countNews(2, (COMPUTERPLAYER *) 0);
+    ok &= check("look-ahead, threads",
+                countNews((int) lookAhead, (COMPUTERPLAYER *) 0), perSplit);
+    ok &= check("choosing a move, threads",
+                countNews((int) lookAhead, &player),
+                perSplit * (lookAhead - 1));
+
+    return(ok ? 0 : 1);
+  }
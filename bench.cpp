@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "misc.hpp"
+#include "brdsize.hpp"
+#include "chess.hpp"
+#include "cplayer.hpp"
+#include "bench.hpp"
+
+// the positions, each given by the moves (in coordinate notation) to
+// reach it from the initial position
+LOCAL const char *benchLine[] =
+  {
+    // initial position
+    "",
+    // ruy lopez
+    "e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6 e1g1 f8e7 f1e1 b7b5 a4b3 "
+    "d7d6 c2c3 e8g8",
+    // sicilian najdorf
+    "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3 a7a6 c1e3 e7e5 d4b3 "
+    "c8e6 f2f3 f8e7",
+    // queen's gambit declined
+    "d2d4 d7d5 c2c4 e7e6 b1c3 g8f6 c1g5 f8e7 e2e3 e8g8 g1f3 b8d7 a1c1 "
+    "c7c6",
+    // king's indian
+    "d2d4 g8f6 c2c4 g7g6 b1c3 f8g7 e2e4 d7d6 g1f3 e8g8 f1e2 e7e5 e1g1 "
+    "b8c6 d4d5 c6e7",
+    // evans gambit
+    "e2e4 e7e5 g1f3 b8c6 f1c4 f8c5 b2b4 c5b4 c2c3 b4a5 d2d4 e5d4 e1g1 "
+    "d4c3",
+    // scandinavian
+    "e2e4 d7d5 e4d5 d8d5 b1c3 d5a5 d2d4 g8f6 g1f3 c8f5 f1c4 e7e6 c1d2 "
+    "c7c6",
+    // french advance
+    "e2e4 e7e6 d2d4 d7d5 e4e5 c7c5 c2c3 b8c6 g1f3 d8b6 a2a3 c5c4"
+  };
+
+// do the move, given in coordinate notation, if it is legal.  returns
+// FALSE if it is not.
+LOCAL BOOL doTextMove
+  (
+    BOARD &board,
+    PIECECOLOR color,
+    const char *text
+  )
+  {
+    PIECEMOVE move;
+
+    if (!FindTextMove(board, color, text, move))
+      return(FALSE);
+
+    DoPieceMove(board, color, move);
+
+    return(TRUE);
+  }
+
+void Bench(int lookAhead)
+  {
+    unsigned long long nodes, totalNodes = 0;
+    CLOCKTIME start, elapsed, totalTime = 0;
+    unsigned checksum = 2166136261U;
+    char text[8];
+    const char *line;
+    PIECECOLOR color;
+    PIECEMOVE move;
+    int i, n;
+
+    for (i = 0; i < (int) ARRAY_LENGTH(benchLine); i++)
+      {
+        BOARD board;
+
+        color = WHITE;
+        for (line = benchLine[i]; *line; line += n)
+          {
+            // next move of the line
+            while (*line == ' ')
+              line++;
+            for (n = 0; line[n] && (line[n] != ' '); n++)
+              ;
+            if ((n == 0) || (n >= (int) sizeof(text)))
+              break;
+            memcpy(text, line, n);
+            text[n] = '\0';
+
+            if (!doTextMove(board, color, text))
+              {
+                fprintf(stderr, "bench line %d: bad move %s\n", i, text);
+                exit(1);
+              }
+            color = OtherColor(color);
+          }
+
+        COMPUTERPLAYER player(color, lookAhead);
+
+        start = ClockNow();
+        player.chooseMove(board, move);
+        MoveText(color, move, text);
+        elapsed = ClockNow() - start;
+        nodes = board.searchStats().total();
+
+        printf("%2d %-6s %12llu nodes %9.3f s\n", i + 1, text, nodes,
+               elapsed / 1000000.0);
+
+        totalNodes += nodes;
+        totalTime += elapsed;
+
+        // FNV-1a hash of the moves chosen
+        for (n = 0; text[n]; n++)
+          checksum = (checksum ^ (unsigned char) text[n]) * 16777619U;
+        checksum = (checksum ^ ' ') * 16777619U;
+      }
+
+    printf("\nnodes: %llu\ntime: %.3f s\n", totalNodes,
+           totalTime / 1000000.0);
+    if (totalTime > 0)
+      printf("nodes/second: %.0f\n", totalNodes * 1000000.0 / totalTime);
+    printf("checksum: %08x\n", checksum);
+
+    return;
+  }
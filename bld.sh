@@ -1,2 +1,5 @@
-gcc --std=c++14 -O3 main.cpp charui.cpp chcharui.cpp chess.cpp chessui.cpp \
-  cplayer.cpp uplayer.cpp -lstdc++ -o chess
+gcc --std=c++14 -O3 -pthread main.cpp bench.cpp book.cpp charui.cpp chcharui.cpp chess.cpp \
+  chessui.cpp cplayer.cpp perft.cpp tbase.cpp thrdpool.cpp uplayer.cpp -lstdc++ -lm -o chess
+gcc --std=c++14 -O3 -pthread allocchk.cpp bench.cpp book.cpp charui.cpp chcharui.cpp \
+  chess.cpp chessui.cpp cplayer.cpp perft.cpp tbase.cpp thrdpool.cpp uplayer.cpp \
+  -lstdc++ -lm -o allocchk
@@ -0,0 +1,312 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <vector>
+
+#include "misc.hpp"
+#include "brdsize.hpp"
+#include "chess.hpp"
+#include "book.hpp"
+
+// bytes in each entry of a book
+const int BOOKENTRYSIZE = 16;
+
+// the book mapped into memory by OpenBook
+LOCAL const unsigned char *book;
+LOCAL long nBookEntries;
+
+// reads a big-endian number of the given number of bytes
+LOCAL inline unsigned long long readBigEndian
+  (
+    const unsigned char *bytes,
+    int nBytes
+  )
+  {
+    unsigned long long n = 0;
+
+    while (nBytes--)
+      n = (n << 8) | *bytes++;
+
+    return(n);
+  }
+
+LOCAL inline void writeBigEndian
+  (
+    unsigned char *bytes,
+    unsigned long long n,
+    int nBytes
+  )
+  {
+    while (nBytes--)
+      {
+        bytes[nBytes] = (unsigned char) n;
+        n >>= 8;
+      }
+
+    return;
+  }
+
+// the promotion piece in bits 12 - 14 of a Polyglot move (0 if none)
+LOCAL const char bookPromoteLetter[] = " nbrq";
+
+// encodes a move as in a Polyglot book.  the to and from squares are
+// in bits 0 - 5 and 6 - 11, each as the file in the low 3 bits and the
+// rank in the high 3 bits.  a castle is encoded as the king taking its
+// own rook.
+LOCAL unsigned encodeMove(PIECECOLOR color, const PIECEMOVE &move)
+  {
+    // POSITION.row is the file and POSITION.col is the rank
+    POSITION start = move.start, end = move.end;
+    unsigned code;
+
+    if (move.type != NORMALMOVE)
+      {
+        start = POSITION(4, color == WHITE ? 0 : (NUMCOLS - 1));
+        end = POSITION(move.type == KINGSIDECASTLE ? 7 : 0, start.col);
+      }
+
+    code = end.row | (end.col << 3) | (start.row << 6) | (start.col << 9);
+
+    if (move.type == NORMALMOVE)
+      switch (move.promoteType)
+        {
+        case TYPEKNIGHT: code |= 1 << 12; break;
+        case TYPEBISHOP: code |= 2 << 12; break;
+        case TYPEROOK:   code |= 3 << 12; break;
+        case TYPEQUEEN:  code |= 4 << 12; break;
+        default:         break;
+        }
+
+    return(code);
+  }
+
+// writes a move encoded as in a Polyglot book in the notation of
+// MoveText.  the board is needed to tell a castle from a rook move.
+LOCAL void decodeMove
+  (
+    const BOARD &board,
+    unsigned code,
+    char *text
+  )
+  {
+    POSITION start((code >> 6) & 7, (code >> 9) & 7),
+             end(code & 7, (code >> 3) & 7);
+    unsigned promote = (code >> 12) & 7;
+    PIECE *p = board.whatPiece(start);
+
+    if (p && (p->whatType() == TYPEKING) && (start.col == end.col) &&
+        ((end.row == 0) || (end.row == 7)) && (start.row == 4))
+      // the king taking its own rook is a castle
+      end.row = end.row == 7 ? 6 : 2;
+
+    text[0] = (char) ('a' + start.row);
+    text[1] = (char) ('1' + start.col);
+    text[2] = (char) ('a' + end.row);
+    text[3] = (char) ('1' + end.col);
+    text[4] = '\0';
+    if ((promote > 0) && (promote < sizeof(bookPromoteLetter) - 1))
+      text[4] = bookPromoteLetter[promote];
+    text[5] = '\0';
+
+    return;
+  }
+
+BOOL OpenBook(const char *fileName)
+  {
+    struct stat st;
+    void *mapped;
+    int fd;
+
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+      return(FALSE);
+
+    if (fstat(fd, &st) || (st.st_size == 0) ||
+        (st.st_size % BOOKENTRYSIZE))
+      {
+        close(fd);
+        return(FALSE);
+      }
+
+    mapped = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+      return(FALSE);
+
+    book = (const unsigned char *) mapped;
+    nBookEntries = st.st_size / BOOKENTRYSIZE;
+
+    return(TRUE);
+  }
+
+BOOL BookMove(const BOARD &board, PIECECOLOR color, PIECEMOVE &move)
+  {
+    HASHKEY key = board.whatHashKey(color);
+    long low = 0, high = nBookEntries, middle;
+    unsigned weight, bestWeight = 0;
+    const unsigned char *entry;
+    PIECEMOVE bookMove;
+    BOOL found = FALSE;
+    char text[6];
+
+    // find the first entry with the key
+    while (low < high)
+      {
+        middle = low + ((high - low) / 2);
+        if (readBigEndian(book + (middle * BOOKENTRYSIZE), 8) < key)
+          low = middle + 1;
+        else
+          high = middle;
+      }
+
+    for ( ; low < nBookEntries; low++)
+      {
+        entry = book + (low * BOOKENTRYSIZE);
+        if (readBigEndian(entry, 8) != key)
+          break;
+
+        weight = (unsigned) readBigEndian(entry + 10, 2);
+        if (found && (weight <= bestWeight))
+          continue;
+
+        // a move that is not legal means another position has the
+        // same key
+        decodeMove(board, (unsigned) readBigEndian(entry + 8, 2), text);
+        if (FindTextMove(board, color, text, bookMove))
+          {
+            move = bookMove;
+            bestWeight = weight;
+            found = TRUE;
+          }
+      }
+
+    return(found);
+  }
+
+// an entry of a book being made
+class BOOKENTRY
+  {
+  public:
+    HASHKEY key;
+    unsigned move;
+    unsigned weight;
+
+    BOOL operator < (const BOOKENTRY &e) const
+      { return((key < e.key) || ((key == e.key) && (move < e.move))); }
+  };
+
+// most characters in a line of the text file read by MakeBook
+const int MAXBOOKLINE = 2048;
+
+BOOL MakeBook(const char *linesFileName, const char *bookFileName)
+  {
+    std::vector<BOOKENTRY> entries;
+    BOOKENTRY entry;
+    char line[MAXBOOKLINE], *text;
+    unsigned char bytes[BOOKENTRYSIZE];
+    PIECECOLOR color;
+    PIECEMOVE move;
+    unsigned e, n;
+    int lineNumber = 0;
+    FILE *f;
+
+    f = fopen(linesFileName, "r");
+    if (!f)
+      {
+        fprintf(stderr, "Cannot read %s\n", linesFileName);
+        return(FALSE);
+      }
+
+    while (fgets(line, sizeof(line), f))
+      {
+        BOARD board;
+
+        lineNumber++;
+        if ((text = strchr(line, '#')))
+          *text = '\0';
+
+        color = WHITE;
+        for (text = strtok(line, " \t\r\n"); text;
+             text = strtok((char *) 0, " \t\r\n"))
+          {
+            if (!FindTextMove(board, color, text, move))
+              {
+                fprintf(stderr, "%s line %d:  illegal move %s\n",
+                        linesFileName, lineNumber, text);
+                fclose(f);
+                return(FALSE);
+              }
+
+            entry.key = board.whatHashKey(color);
+            entry.move = encodeMove(color, move);
+            entry.weight = 1;
+            entries.push_back(entry);
+
+            DoPieceMove(board, color, move);
+            color = OtherColor(color);
+          }
+      }
+
+    fclose(f);
+
+    // combine the entries for the same move from the same position
+    std::sort(entries.begin(), entries.end());
+    for (n = 0, e = 0; e < entries.size(); e++)
+      if (n && (entries[n - 1].key == entries[e].key) &&
+          (entries[n - 1].move == entries[e].move))
+        entries[n - 1].weight++;
+      else
+        entries[n++] = entries[e];
+    entries.resize(n);
+
+    f = fopen(bookFileName, "wb");
+    if (!f)
+      {
+        fprintf(stderr, "Cannot write %s\n", bookFileName);
+        return(FALSE);
+      }
+
+    for (e = 0; e < entries.size(); e++)
+      {
+        writeBigEndian(bytes, entries[e].key, 8);
+        writeBigEndian(bytes + 8, entries[e].move, 2);
+        writeBigEndian(bytes + 10,
+                       entries[e].weight > 0xFFFF ? 0xFFFF :
+                                                    entries[e].weight, 2);
+        writeBigEndian(bytes + 12, 0, 4);
+        fwrite(bytes, BOOKENTRYSIZE, 1, f);
+      }
+
+    if (fclose(f))
+      {
+        fprintf(stderr, "Cannot write %s\n", bookFileName);
+        return(FALSE);
+      }
+
+    printf("%u positions and moves written to %s\n", n, bookFileName);
+
+    return(TRUE);
+  }
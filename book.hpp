@@ -0,0 +1,50 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#if !defined(BOOK_HPP)
+#define BOOK_HPP
+
+#include "misc.hpp"
+#include "chess.hpp"
+
+// an opening book is a file of 16-byte entries, sorted by key, with
+// the layout of a Polyglot book:  the hash key of a position (with
+// the color to move) in 8 bytes, a move from the position in 2 bytes,
+// the weight of the move in 2 bytes, and 4 unused bytes, all
+// big-endian.  the moves are encoded as in Polyglot, but the keys are
+// those of BOARD::whatHashKey, so the program can only use books it
+// made itself.
+
+// maps the book in the file into memory, for use by BookMove.
+// returns FALSE if the file cannot be used as a book.
+BOOL OpenBook(const char *fileName);
+
+// looks up the position on the board, with the given color to move,
+// in the book.  if found, returns TRUE, with the legal move of the
+// highest weight in the book in move.
+BOOL BookMove(const BOARD &board, PIECECOLOR color, PIECEMOVE &move);
+
+// makes a book from a text file of lines of moves in coordinate
+// notation, each line starting from the initial position.  text after
+// a '#' is ignored.  the weight of a move is the number of lines it
+// is in.  returns FALSE (after printing a message) if the text file
+// cannot be read, has an illegal move, or the book cannot be written.
+BOOL MakeBook(const char *linesFileName, const char *bookFileName);
+
+#endif
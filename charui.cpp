@@ -25,6 +25,7 @@ using namespace std;
 #include <unistd.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include "misc.hpp"
 #include "brdsize.hpp"
@@ -35,14 +36,33 @@ CHARUSERIFACE CharUI;
 namespace
 {
 
-int tty_fd;
+int tty_fd = -1;
+
+// output is collected here, and written to the terminal by tty_flush
+char out_buf[4096];
+int out_len;
+
+void tty_flush()
+  {
+    int done = 0, n;
+
+    while (done < out_len)
+      {
+        n = static_cast<int>(write(tty_fd, out_buf + done, out_len - done));
+        if (n <= 0)
+          break;
+        done += n;
+      }
+
+    out_len = 0;
+  }
 
 void tty_wr(int c)
   {
-    char b[1];
-    b[0] = static_cast<char>(c);
+    if (out_len == static_cast<int>(sizeof(out_buf)))
+      tty_flush();
 
-    static_cast<void>(write(tty_fd, b, 1));
+    out_buf[out_len++] = static_cast<char>(c);
   }
 
 const int ESC = 0x1b;
@@ -64,6 +84,143 @@ void num2d(int n)
     tty_wr((n % 10) + '0');
   }
 
+// a character cell of the screen
+class CELL
+  {
+  public:
+    char c;
+    BOOL inverse;
+
+    BOOL operator != (const CELL &cell) const
+      { return((c != cell.c) || (inverse != cell.inverse)); }
+  };
+
+// the part of the screen that is kept track of.  characters shown
+// outside of it are ignored.
+const int SCREENROWS = 64;
+const int SCREENCOLS = 128;
+
+// characters are assumed to wrap to the next line after this column
+const int LINECOLS = 80;
+
+// what the screen shows now, and what it is to show after the next
+// flush
+CELL onScreen[SCREENROWS][SCREENCOLS];
+CELL wanted[SCREENROWS][SCREENCOLS];
+
+// TRUE for a row of wanted that may differ from onScreen
+BOOL rowChanged[SCREENROWS];
+
+// where the cursor is, cursorRow is -1 if not known
+int cursorRow = -1, cursorCol;
+
+// TRUE if the screen is set to show characters in inverse-video
+BOOL sgrInverse = FALSE;
+
+// set all the cells to blank, as they are after clearing the screen
+void clearCells()
+  {
+    int row, col;
+
+    for (row = 0; row < SCREENROWS; row++)
+      {
+        for (col = 0; col < SCREENCOLS; col++)
+          {
+            onScreen[row][col].c = ' ';
+            onScreen[row][col].inverse = FALSE;
+            wanted[row][col] = onScreen[row][col];
+          }
+        rowChanged[row] = FALSE;
+      }
+  }
+
+void setInverse(BOOL inverse)
+  {
+    if (inverse == sgrInverse)
+      return;
+
+    csi();
+    if (inverse)
+      {
+        tty_wr('3');
+        tty_wr('0');
+        tty_wr(';');
+        tty_wr('4');
+        tty_wr('7');
+      }
+    else
+      {
+        tty_wr('3');
+        tty_wr('7');
+        tty_wr(';');
+        tty_wr('4');
+        tty_wr('0');
+      }
+    tty_wr('m');
+
+    sgrInverse = inverse;
+  }
+
+// a cursor move is not sent to go right by this many cells or fewer,
+// the unchanged characters in between are sent again instead
+const int MAXRESEND = 4;
+
+// send the characters in wanted that differ from onScreen
+void sendChanges()
+  {
+    int row, col, c;
+
+    for (row = 0; row < SCREENROWS; row++)
+      {
+        if (!rowChanged[row])
+          continue;
+        rowChanged[row] = FALSE;
+
+        for (col = 0; col < SCREENCOLS; col++)
+          {
+            if (!(wanted[row][col] != onScreen[row][col]))
+              continue;
+
+            if ((cursorRow != row) || (cursorCol != col))
+              {
+                if ((cursorRow == row) && (cursorCol < col) &&
+                    ((col - cursorCol) <= MAXRESEND))
+                  {
+                    for (c = cursorCol; c < col; c++)
+                      if (wanted[row][c].inverse != sgrInverse)
+                        break;
+                  }
+                else
+                  c = -1;
+
+                if (c == col)
+                  // characters in between are all shown with the
+                  // current attribute
+                  for (c = cursorCol; c < col; c++)
+                    tty_wr(wanted[row][c].c);
+                else
+                  {
+                    // position cursor
+                    csi();
+                    num2d(row + 1);
+                    tty_wr(';');
+                    num2d(col + 1);
+                    tty_wr('H');
+                  }
+              }
+
+            setInverse(wanted[row][col].inverse);
+            tty_wr(wanted[row][col].c);
+            onScreen[row][col] = wanted[row][col];
+
+            cursorRow = row;
+            cursorCol = col + 1;
+            if (cursorCol >= LINECOLS)
+              cursorRow = -1;
+          }
+      }
+  }
+
 int tty_rd()
   {
     unsigned char c;
@@ -80,7 +237,14 @@ termios save_tios;
 
 CHARUSERIFACE::CHARUSERIFACE(void)
   {
-    tty_fd = open("/dev/tty", O_RDWR);
+  }
+
+void CHARUSERIFACE::open(void)
+  {
+    if (tty_fd >= 0)
+      return;
+
+    tty_fd = ::open("/dev/tty", O_RDWR);
     if (tty_fd < 0)
       {
         fprintf(stderr, "Error opening /dev/tty\n");
@@ -120,11 +284,22 @@ CHARUSERIFACE::CHARUSERIFACE(void)
     csi();
     tty_wr(CLEAR_SCREEN);
 
+    clearCells();
+    cursorRow = 0;
+    cursorCol = 0;
+
+    tty_flush();
+
     return;
   }
 
 CHARUSERIFACE::~CHARUSERIFACE(void)
   {
+    if (tty_fd < 0)
+      return;
+
+    setInverse(FALSE);
+
     csi();
     tty_wr(CURSOR_HOME);
 
@@ -138,6 +313,8 @@ CHARUSERIFACE::~CHARUSERIFACE(void)
     tty_wr('5');
     tty_wr('h');
 
+    tty_flush();
+
     tcsetattr(tty_fd, TCSANOW, &save_tios);
 
     close(tty_fd);
@@ -145,43 +322,32 @@ CHARUSERIFACE::~CHARUSERIFACE(void)
 
 void CHARUSERIFACE::showChar(int row, int col, char c, BOOL inverse)
   {
-    // Position cursor.
-    csi();
-    num2d(row + 1);
-    tty_wr(';');
-    num2d(col + 1);
-    tty_wr('H');
+    if ((row < 0) || (row >= SCREENROWS) || (col < 0) || (col >= SCREENCOLS))
+      return;
 
-    if (inverse)
-      {
-        csi();
-        tty_wr('3');
-        tty_wr('0');
-        tty_wr(';');
-        tty_wr('4');
-        tty_wr('7');
-        tty_wr('m');
-      }
+    wanted[row][col].c = c;
+    wanted[row][col].inverse = inverse;
+    rowChanged[row] = TRUE;
 
-    tty_wr(c);
+    return;
+  }
 
-    if (inverse)
-      {
-        csi();
-        tty_wr('3');
-        tty_wr('7');
-        tty_wr(';');
-        tty_wr('4');
-        tty_wr('0');
-        tty_wr('m');
-      }
+void CHARUSERIFACE::flush(void)
+  {
+    sendChanges();
+    tty_flush();
 
     return;
   }
 
 uint CHARUSERIFACE::readKey(void)
   {
-    int c = tty_rd();
+    int c;
+
+    // the user must see everything shown before being asked for a key
+    flush();
+
+    c = tty_rd();
 
     if ((c == 'x') || (c == 'X'))
       return(KEYEXIT);
@@ -198,3 +364,18 @@ uint CHARUSERIFACE::readKey(void)
 
     return(c);
   }
+
+uint CHARUSERIFACE::pollKey(int milliseconds)
+  {
+    pollfd p;
+
+    flush();
+
+    p.fd = tty_fd;
+    p.events = POLLIN;
+
+    if (poll(&p, 1, milliseconds) <= 0)
+      return(KEYNONE);
+
+    return(readKey());
+  }
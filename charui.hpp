@@ -30,6 +30,11 @@ class CHARUSERIFACE
     CHARUSERIFACE(void);
     ~CHARUSERIFACE(void);
 
+    // take over the terminal.  it is not done by the constructor, so
+    // that the program can be run without a terminal when it is not
+    // playing a game.
+    CLASSMEMBER void open(void);
+
     // show a character on the screen
     CLASSMEMBER void showChar
       (
@@ -44,13 +49,25 @@ class CHARUSERIFACE
     CLASSMEMBER void showChar(POSITION p, char c, BOOL inverse)
       { showChar(p.row, p.col, c, inverse); return; }
 
+    // characters shown are saved up, and sent to the screen together
+    // by flush (or by readKey).  only the characters that differ from
+    // what the screen already shows are sent.  this must be called at
+    // the end of each operation that changes the screen.
+    CLASSMEMBER void flush(void);
+
     // wait for key press by user, return its code.  codes are
     // ASCII codes for characters corresponding to keys, except for
     // those listed below.
     CLASSMEMBER uint readKey(void);
+
+    // wait up to the given number of milliseconds for a key press by
+    // the user.  returns the code of the key, as for readKey, or
+    // KEYNONE if no key was pressed in that time.
+    CLASSMEMBER uint pollKey(int milliseconds);
   };
 
 // codes for non-character keys
+const uint KEYNONE = 0;
 const uint KEYEXIT = 1 << 8;
 const uint KEYENTER = 0x000D;
 const uint KEYUP = (1 << 8) | 'A';
@@ -61,6 +61,8 @@ void CHESSCHARUSERIFACE::initScreen(void)
     POSITION board, screen, position;
     BOOL inverse;
 
+    CharUI.open();
+
     // display empty board
     screen.row = 0;
     for (board.row = 0; board.row < NUMROWS; board.row++)
@@ -305,6 +307,29 @@ BOOL CHESSCHARUSERIFACE::showMessage
       }
   }
 
+BOOL CHESSCHARUSERIFACE::pollKey
+  (
+    int milliseconds,
+    const char *keyList,
+    uint *keyIndex
+  )
+  {
+    uint keyPressed, i;
+
+    keyPressed = CharUI.pollKey(milliseconds);
+
+    if (keyPressed == KEYEXIT)
+      return(FALSE);
+
+    for (i = 0; keyList[i]; i++)
+      if (keyList[i] == (char) keyPressed)
+        break;
+
+    *keyIndex = i;
+
+    return(TRUE);
+  }
+
 void CHESSCHARUSERIFACE::setSelect(POSITION whereBoard)
   {
     showBoardText
@@ -380,3 +405,10 @@ BOOL CHESSCHARUSERIFACE::selectPosition
           whereBoard.col++;
       }
   }
+
+void CHESSCHARUSERIFACE::flush(void)
+  {
+    CharUI.flush();
+
+    return;
+  }
@@ -66,6 +66,19 @@ class CHESSCHARUSERIFACE
         uint *keyIndex
       );
 
+    // wait up to the given number of milliseconds for the user to
+    // press a key, without showing a message.  if the exit key is
+    // pressed the function returns FALSE.  otherwise, the function
+    // returns TRUE, and keyIndex is set to the index of the character
+    // in keyList corresponding to the key pressed, or to the length of
+    // keyList if no key in it was pressed in time.
+    CLASSMEMBER BOOL pollKey
+      (
+        int milliseconds,
+        const char *keyList,
+        uint *keyIndex
+      );
+
     // display a message, then let the user select a position on the 
     // chess board.  if the user pressed the escape key, the function
     // returns FALSE.  Otherwise the function returns TRUE, and the
@@ -80,6 +93,12 @@ class CHESSCHARUSERIFACE
     CLASSMEMBER void setSelect(POSITION whereBoard);
     // clears highlight of a position on the board
     CLASSMEMBER void clearSelect(POSITION whereBoard);
+
+    // send the changes to the screen.  changes are saved up until this
+    // is called, or until the user is asked to press a key, so this
+    // must be called at the end of each operation of the top layer
+    // that doesn't wait for a key.
+    CLASSMEMBER void flush(void);
   };
 
 // only instance of this class
@@ -17,9 +17,19 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
 #include "misc.hpp"
 #include "brdsize.hpp"
 #include "chess.hpp"
+#include "thrdpool.hpp"
 
 extern void OutOfMemory(void);
 
@@ -35,12 +45,15 @@ class PAWN : public PIECE
   {
   private:
     // pointer to piece to which pawn has been promoted.  null if
-    // pawn has not been promoted.
-    PIECE *promotePiece;
+    // pawn has not been promoted.  the piece is shared with all other
+    // pawns of the same color promoted to the same type (see
+    // promotedQueen), so it is not copied or deleted with the pawn.
+    const PIECE *promotePiece;
 
   public:
     PAWN(PIECECOLOR c) : PIECE(c, TYPEPAWN, VALUEPAWN), promotePiece(0) { }
-    virtual ~PAWN(void) { if (promotePiece) delete promotePiece; }
+
+    virtual PIECE *clone(void) const { return(new PAWN(*this)); }
 
     void promote(PIECETYPE promoteType);
     void restoreToPawn(void);
@@ -75,6 +88,8 @@ class ROOK : public PIECE
   public:
     ROOK(PIECECOLOR c) : PIECE(c, TYPEROOK, VALUEROOK)  { }
 
+    virtual PIECE *clone(void) const { return(new ROOK(*this)); }
+
     virtual void legalMoves
       (
         POSITION start,
@@ -89,6 +104,8 @@ class KNIGHT : public PIECE
   public:
     KNIGHT(PIECECOLOR c) : PIECE(c, TYPEKNIGHT, VALUEKNIGHT)  { }
 
+    virtual PIECE *clone(void) const { return(new KNIGHT(*this)); }
+
     virtual void legalMoves
       (
         POSITION start,
@@ -103,6 +120,8 @@ class BISHOP : public PIECE
   public:
     BISHOP(PIECECOLOR c) : PIECE(c, TYPEBISHOP, VALUEBISHOP)  { }
 
+    virtual PIECE *clone(void) const { return(new BISHOP(*this)); }
+
     virtual void legalMoves
       (
         POSITION start,
@@ -117,6 +136,8 @@ class QUEEN : public PIECE
   public:
     QUEEN(PIECECOLOR c) : PIECE(c, TYPEQUEEN, VALUEQUEEN)  { }
 
+    virtual PIECE *clone(void) const { return(new QUEEN(*this)); }
+
     virtual void legalMoves
       (
         POSITION start,
@@ -131,6 +152,8 @@ class KING : public PIECE
   public:
     KING(PIECECOLOR c) : PIECE(c, TYPEKING, VALUEKING)  { }
 
+    virtual PIECE *clone(void) const { return(new KING(*this)); }
+
     virtual void legalMoves
       (
         POSITION start,
@@ -140,6 +163,88 @@ class KING : public PIECE
 
   };
 
+// pieces that pawns are promoted to, indexed by color.  promoted pawns
+// only use these for their type, value and moves, so all can share
+// them, and promotions (which are done and undone throughout the
+// look-ahead) don't allocate memory.
+LOCAL const QUEEN promotedQueen[] = { QUEEN(WHITE), QUEEN(BLACK) };
+LOCAL const ROOK promotedRook[] = { ROOK(WHITE), ROOK(BLACK) };
+LOCAL const BISHOP promotedBishop[] = { BISHOP(WHITE), BISHOP(BLACK) };
+LOCAL const KNIGHT promotedKnight[] = { KNIGHT(WHITE), KNIGHT(BLACK) };
+
+// random numbers used to form the zobrist hash key of a board.  the
+// key is the exclusive or of the numbers for each piece in its
+// position, the en passant state, the castling rights and the color
+// to move.
+LOCAL class ZOBRISTKEYS
+  {
+  public:
+    // indexed by PIECECOLOR, PIECETYPE, and position
+    HASHKEY piece[2][TYPENOPIECE][NUMROWS][NUMCOLS];
+    // indexed by the position of the last double-moved pawn
+    HASHKEY enPassant[NUMROWS][NUMCOLS];
+    // indexed by castling rights bit mask
+    HASHKEY castle[16];
+    HASHKEY blackToMove;
+    // for results of searches that continue with captures after the
+    // last move of look-ahead
+    HASHKEY quiesceLeaves;
+
+    ZOBRISTKEYS(void)
+      {
+        // fixed seed, so keys are the same from run to run
+        HASHKEY seed = 0x9E3779B97F4A7C15ULL;
+        int c, t, r, col;
+
+        for (c = 0; c < 2; c++)
+          for (t = 0; t < TYPENOPIECE; t++)
+            for (r = 0; r < NUMROWS; r++)
+              for (col = 0; col < NUMCOLS; col++)
+                piece[c][t][r][col] = random(seed);
+
+        for (r = 0; r < NUMROWS; r++)
+          for (col = 0; col < NUMCOLS; col++)
+            enPassant[r][col] = random(seed);
+
+        // no castling rights is 0, so a board with no castling
+        // possible doesn't need to be updated
+        castle[0] = 0;
+        for (c = 1; c < 16; c++)
+          castle[c] = random(seed);
+
+        blackToMove = random(seed);
+        quiesceLeaves = random(seed);
+      }
+
+  private:
+    // splitmix64 pseudo-random number generator
+    CLASSMEMBER HASHKEY random(HASHKEY &seed)
+      {
+        HASHKEY z = (seed += 0x9E3779B97F4A7C15ULL);
+
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return(z ^ (z >> 31));
+      }
+  }
+ZobristKeys;
+
+// key for the given piece in the given position
+LOCAL inline HASHKEY pieceKey(const PIECE *p, POSITION where)
+  {
+    return(ZobristKeys.piece[p->whatColor()][p->whatType()]
+                            [where.row][where.col]);
+  }
+
+// returns TRUE if a move to or from the given position could change
+// the castling rights
+LOCAL inline BOOL isCastleSquare(POSITION where)
+  {
+    return(((where.col == 0) || (where.col == (NUMCOLS - 1))) &&
+           ((where.row == 0) || (where.row == 4) ||
+            (where.row == (NUMROWS - 1))));
+  }
+
 // put all the pieces for one color at their starting positions on
 // the board
 LOCAL void setupPieces
@@ -192,6 +297,42 @@ BOARD::BOARD(void)
 
     wasLastMoveDoublePawn = FALSE;
 
+    hashKey = computeHashKey();
+    attacksTracked = FALSE;
+    computeBits();
+
+    setDeadline(0);
+    stats.clear();
+
+    return;
+  }
+
+BOARD::BOARD(const BOARD &board)
+  {
+    int row, col;
+
+    for (row = 0; row < NUMROWS; row++)
+      for (col = 0; col < NUMCOLS; col++)
+        if (board.brd[row][col])
+          {
+            if (!(brd[row][col] = board.brd[row][col]->clone()))
+              OutOfMemory();
+          }
+        else
+          brd[row][col] = (PIECE *) 0;
+
+    wasLastMoveDoublePawn = board.wasLastMoveDoublePawn;
+    doubleMovedPawn = board.doubleMovedPawn;
+    hashKey = board.hashKey;
+    attacksTracked = FALSE;
+    computeBits();
+    deadline = board.deadline;
+    searchAbandoned = board.searchAbandoned;
+    untilClockCheck = board.untilClockCheck;
+    // a copy made by a search thread counts only its own positions
+    stats.clear();
+    stats.lookAhead = board.stats.lookAhead;
+
     return;
   }
 
@@ -209,7 +350,448 @@ BOARD::~BOARD(void)
     return;
   }
 
+// letters for the piece types in FEN, upper case for white, indexed
+// by PIECETYPE
+LOCAL const char fenLetter[] = "KQBNRP";
+
+// creates a piece for a letter of the piece placement field of a FEN
+// record.  returns null if the letter is not a piece.
+LOCAL PIECE *fenPiece(char letter)
+  {
+    PIECECOLOR color = (letter >= 'a') ? BLACK : WHITE;
+    PIECE *p;
+
+    switch (color == BLACK ? letter - ('a' - 'A') : letter)
+      {
+      case 'P':
+        p = new PAWN(color);
+        break;
+
+      case 'R':
+        p = new ROOK(color);
+        break;
+
+      case 'N':
+        p = new KNIGHT(color);
+        break;
+
+      case 'B':
+        p = new BISHOP(color);
+        break;
+
+      case 'Q':
+        p = new QUEEN(color);
+        break;
+
+      case 'K':
+        p = new KING(color);
+        break;
+
+      default:
+        return((PIECE *) 0);
+      }
+
+    if (!p)
+      OutOfMemory();
+
+    return(p);
+  }
+
+BOOL BOARD::readFen(const char *fen, PIECECOLOR &moveColor)
+  {
+    PIECE *oldBrd[NUMROWS][NUMCOLS];
+    BOOL oldWasLastMoveDoublePawn = wasLastMoveDoublePawn;
+    POSITION oldDoubleMovedPawn = doubleMovedPawn;
+    PIECECOLOR color = WHITE;
+    POSITION where;
+    BOOL valid = TRUE;
+    int row, col, backCol, nKings[2] = { 0, 0 };
+    const char *c = fen;
+    PIECE *p;
+
+    for (row = 0; row < NUMROWS; row++)
+      for (col = 0; col < NUMCOLS; col++)
+        {
+          oldBrd[row][col] = brd[row][col];
+          brd[row][col] = (PIECE *) 0;
+        }
+
+    // piece placement, from the last rank to the first.  (POSITION.row
+    // is the file and POSITION.col is the rank.)
+    for (col = NUMCOLS - 1; valid && (col >= 0); col--)
+      {
+        for (row = 0; valid && (row < NUMROWS); c++)
+          if ((*c >= '1') && (*c <= '8'))
+            row += *c - '0';
+          else if ((p = fenPiece(*c)) != (PIECE *) 0)
+            {
+              brd[row++][col] = p;
+              if (p->whatType() == TYPEKING)
+                nKings[p->whatColor()]++;
+              // a pawn that is not on its starting rank can't make a
+              // double move
+              else if ((p->whatType() == TYPEPAWN) &&
+                       (col != (p->whatColor() == WHITE ? 1 : 6)))
+                {
+                  p->moveDone();
+                  valid = (col != 0) && (col != (NUMCOLS - 1));
+                }
+            }
+          else
+            valid = FALSE;
+
+        valid = valid && (row == NUMROWS) &&
+                (*c == (col > 0 ? '/' : ' '));
+        c++;
+      }
+
+    valid = valid && (nKings[WHITE] == 1) && (nKings[BLACK] == 1);
+
+    // color to move
+    if (valid)
+      {
+        if (*c == 'b')
+          color = BLACK;
+        else
+          valid = *c == 'w';
+        c++;
+        valid = valid && (*c++ == ' ');
+      }
+
+    // castling.  every piece on the first and last ranks is marked as
+    // having been moved, and then the king and rooks of the castles
+    // allowed are marked as not moved.
+    if (valid)
+      {
+        for (col = 0; col < NUMCOLS; col += NUMCOLS - 1)
+          for (row = 0; row < NUMROWS; row++)
+            if (brd[row][col])
+              brd[row][col]->moveDone();
+
+        if (*c == '-')
+          c++;
+        else
+          for ( ; valid && (*c != ' ') && *c; c++)
+            {
+              backCol = (*c >= 'a') ? (NUMCOLS - 1) : 0;
+              switch (*c)
+                {
+                case 'K':
+                case 'k':
+                  row = NUMROWS - 1;
+                  break;
+
+                case 'Q':
+                case 'q':
+                  row = 0;
+                  break;
+
+                default:
+                  valid = FALSE;
+                  continue;
+                }
+
+              valid =
+                brd[4][backCol] &&
+                (brd[4][backCol]->whatType() == TYPEKING) &&
+                (brd[4][backCol]->whatColor() ==
+                 (backCol ? BLACK : WHITE)) &&
+                brd[row][backCol] &&
+                (brd[row][backCol]->whatType() == TYPEROOK) &&
+                (brd[row][backCol]->whatColor() ==
+                 brd[4][backCol]->whatColor());
+              if (valid)
+                {
+                  if (brd[4][backCol]->hasBeenMoved())
+                    brd[4][backCol]->moveUndone();
+                  if (brd[row][backCol]->hasBeenMoved())
+                    brd[row][backCol]->moveUndone();
+                }
+            }
+        valid = valid && (*c++ == ' ');
+      }
+
+    // en passant target, the position the pawn that just made a double
+    // move passed over
+    wasLastMoveDoublePawn = FALSE;
+    if (valid && (*c == '-'))
+      c++;
+    else if (valid)
+      {
+        // the record may end before the field
+        valid = c[0] && c[1];
+        if (valid)
+          {
+            where.row = c[0] - 'a';
+            where.col = c[1] - '1';
+            backCol = color == WHITE ? 5 : 2;
+            valid = (where.row >= 0) && (where.row < NUMROWS) &&
+                    (where.col == backCol);
+            c += 2;
+          }
+        if (valid)
+          {
+            doubleMovedPawn =
+              POSITION(where.row, where.col + (color == WHITE ? -1 : 1));
+            p = brd[doubleMovedPawn.row][doubleMovedPawn.col];
+            valid = !brd[where.row][where.col] &&
+                    !brd[where.row][where.col + (color == WHITE ? 1 : -1)] &&
+                    p && (p->whatType() == TYPEPAWN) &&
+                    (p->whatColor() != color);
+            wasLastMoveDoublePawn = TRUE;
+          }
+      }
+
+    // the move counters, or the operations of an EPD record, are
+    // ignored
+    valid = valid && ((*c == ' ') || !*c);
+
+    if (valid)
+      {
+        hashKey = computeHashKey();
+        computeBits();
+
+        // the player who just moved can't have left the king in check
+        valid = !inCheck(OtherColor(color));
+      }
+
+    if (!valid)
+      {
+        for (row = 0; row < NUMROWS; row++)
+          for (col = 0; col < NUMCOLS; col++)
+            {
+              if (brd[row][col])
+                delete brd[row][col];
+              brd[row][col] = oldBrd[row][col];
+            }
+        wasLastMoveDoublePawn = oldWasLastMoveDoublePawn;
+        doubleMovedPawn = oldDoubleMovedPawn;
+        hashKey = computeHashKey();
+        computeBits();
+
+        return(FALSE);
+      }
+
+    for (row = 0; row < NUMROWS; row++)
+      for (col = 0; col < NUMCOLS; col++)
+        if (oldBrd[row][col])
+          delete oldBrd[row][col];
+
+    moveColor = color;
+
+    return(TRUE);
+  }
+
+void BOARD::writeFen
+  (
+    PIECECOLOR moveColor,
+    char *text,
+    BOOL epd
+  ) const
+  {
+    int row, col, nEmpty, rights = castleRights();
+    const PIECE *p;
+
+    for (col = NUMCOLS - 1; col >= 0; col--)
+      {
+        nEmpty = 0;
+        for (row = 0; row < NUMROWS; row++)
+          {
+            p = brd[row][col];
+            if (!p)
+              {
+                nEmpty++;
+                continue;
+              }
+            if (nEmpty)
+              *text++ = (char) ('0' + nEmpty);
+            nEmpty = 0;
+            *text = fenLetter[p->whatType()];
+            if (p->whatColor() == BLACK)
+              *text += 'a' - 'A';
+            text++;
+          }
+        if (nEmpty)
+          *text++ = (char) ('0' + nEmpty);
+        if (col > 0)
+          *text++ = '/';
+      }
+
+    *text++ = ' ';
+    *text++ = moveColor == WHITE ? 'w' : 'b';
+    *text++ = ' ';
+
+    // see castleRights for the bits
+    if (!rights)
+      *text++ = '-';
+    if (rights & 2)
+      *text++ = 'K';
+    if (rights & 1)
+      *text++ = 'Q';
+    if (rights & 8)
+      *text++ = 'k';
+    if (rights & 4)
+      *text++ = 'q';
+    *text++ = ' ';
+
+    if (wasLastMoveDoublePawn)
+      {
+        *text++ = (char) ('a' + doubleMovedPawn.row);
+        *text++ = (char) ('1' + doubleMovedPawn.col +
+                          (moveColor == WHITE ? 1 : -1));
+      }
+    else
+      *text++ = '-';
+
+    // the moves since the last capture or pawn move, and the move
+    // number, are not kept track of
+    if (!epd)
+      {
+        *text++ = ' ';
+        *text++ = '0';
+        *text++ = ' ';
+        *text++ = '1';
+      }
+
+    *text = '\0';
+
+    return;
+  }
+
+HASHKEY BOARD::computeHashKey(void) const
+  {
+    HASHKEY key = 0;
+    POSITION where;
+
+    for (where.row = 0; where.row < NUMROWS; where.row++)
+      for (where.col = 0; where.col < NUMCOLS; where.col++)
+        if (whatPiece(where))
+          key ^= pieceKey(whatPiece(where), where);
+
+    return(key ^ enPassantKey() ^ ZobristKeys.castle[castleRights()]);
+  }
+
+void BOARD::computeBits(void)
+  {
+    POSITION where;
+    int c, t;
+
+    for (c = 0; c < 2; c++)
+      {
+        for (t = 0; t < TYPENOPIECE; t++)
+          pieceBits[c][t] = 0;
+        colorBits[c] = 0;
+      }
+
+    for (where.row = 0; where.row < NUMROWS; where.row++)
+      for (where.col = 0; where.col < NUMCOLS; where.col++)
+        if (whatPiece(where))
+          {
+            c = whatPiece(where)->whatColor();
+            pieceBits[c][whatPiece(where)->whatType()] |= PositionBit(where);
+            colorBits[c] |= PositionBit(where);
+          }
+
+    if (attacksTracked)
+      computeAttacks();
+
+    return;
+  }
+
+inline void BOARD::flipPiece(const PIECE *p, POSITION where)
+  {
+    BITBOARD bit = PositionBit(where);
+
+    hashKey ^= pieceKey(p, where);
+    pieceBits[p->whatColor()][p->whatType()] ^= bit;
+    colorBits[p->whatColor()] ^= bit;
+
+    if (attacksTracked)
+      updateAttacks(where);
+
+    return;
+  }
+
+// returns TRUE if there is a piece of the given type that has never
+// been moved
+LOCAL inline BOOL unmoved(const PIECE *p, PIECETYPE type)
+  {
+    return(p && (p->whatType() == type) && !p->hasBeenMoved());
+  }
+
+int BOARD::castleRights(void) const
+  {
+    int rights = 0, col, shift;
+
+    // a piece that has never been moved must still be the piece that
+    // started in that position
+    for (shift = 0; shift < 4; shift += 2)
+      {
+        col = shift ? (NUMCOLS - 1) : 0;
+        if (unmoved(brd[4][col], TYPEKING))
+          {
+            if (unmoved(brd[0][col], TYPEROOK))
+              rights |= 1 << shift;
+            if (unmoved(brd[NUMROWS - 1][col], TYPEROOK))
+              rights |= 2 << shift;
+          }
+      }
+
+    return(rights);
+  }
+
+HASHKEY BOARD::enPassantKey(void) const
+  {
+    if (!wasLastMoveDoublePawn)
+      return(0);
+
+    return(ZobristKeys.enPassant[doubleMovedPawn.row][doubleMovedPawn.col]);
+  }
+
+HASHKEY BOARD::whatHashKey(PIECECOLOR moveColor) const
+  {
+    return(moveColor == WHITE ? hashKey :
+                                hashKey ^ ZobristKeys.blackToMove);
+  }
+
 void BOARD::doMove
+  (
+    POSITION start,
+    POSITION end,
+    MOVEUNDODATA &undoData
+  )
+  {
+    PIECE *p;
+    BOOL castleChange = isCastleSquare(start) || isCastleSquare(end);
+
+    undoData.saveHashKey = hashKey;
+
+    hashKey ^= enPassantKey();
+    if (castleChange)
+      hashKey ^= ZobristKeys.castle[castleRights()];
+
+    movePiece(start, end, undoData);
+
+    p = brd[end.row][end.col];
+    flipPiece(p, start);
+    flipPiece(p, end);
+
+    if (undoData.capturedPiece)
+      flipPiece
+        (
+          undoData.capturedPiece,
+          undoData.enPassantEffect == ENPASSANTCAPTURE ?
+            undoData.saveDoubleMoved : end
+        );
+
+    hashKey ^= enPassantKey();
+    if (castleChange)
+      hashKey ^= ZobristKeys.castle[castleRights()];
+
+    return;
+  }
+
+void BOARD::movePiece
   (
     POSITION start,
     POSITION end,
@@ -281,6 +863,18 @@ void BOARD::undoMove
     MOVEUNDODATA undoData
   )
   {
+    // the hash key is restored below, only the position sets need
+    // to be changed back
+    flipPiece(brd[end.row][end.col], end);
+    flipPiece(brd[end.row][end.col], orig);
+    if (undoData.capturedPiece)
+      flipPiece
+        (
+          undoData.capturedPiece,
+          undoData.enPassantEffect == ENPASSANTCAPTURE ?
+            POSITION(end.row, orig.col) : end
+        );
+
     brd[orig.row][orig.col] = brd[end.row][end.col];
 
     brd[orig.row][orig.col]->moveUndone();
@@ -301,14 +895,15 @@ void BOARD::undoMove
         doubleMovedPawn = undoData.saveDoubleMoved;
       }
 
+    hashKey = undoData.saveHashKey;
+
     return;
   }
 
-BOOL BOARD::canCastle(MOVETYPE whichCastle, PIECECOLOR color)
+BOOL BOARD::canCastle(MOVETYPE whichCastle, PIECECOLOR color) const
   {
     int col = color == WHITE ? 0 : 7;
     int row, rowStep;
-    BOARDMETRIC metric;
 
     if (whichCastle == QUEENSIDECASTLE)
       {
@@ -323,13 +918,9 @@ BOOL BOARD::canCastle(MOVETYPE whichCastle, PIECECOLOR color)
 
     // make sure king & rook in initial positions and have never been
     // moved.
-    if (!brd[row][col])
-      return(FALSE);
-    if (brd[row][col]->hasBeenMoved())
-      return(FALSE);
-    if (!brd[4][col])
+    if (!unmoved(brd[row][col], TYPEROOK))
       return(FALSE);
-    if (brd[4][col]->hasBeenMoved())
+    if (!unmoved(brd[4][col], TYPEKING))
       return(FALSE);
 
     // make sure no pieces in between
@@ -343,18 +934,13 @@ BOOL BOARD::canCastle(MOVETYPE whichCastle, PIECECOLOR color)
       }
 
     // make sure king is not in check
-    findBestMoves(1, OtherColor(color), metric, (BESTMOVES *) 0);
-    if (metric.kingSituation[color] == KINGLOST)
+    if (inCheck(color))
       return(FALSE);
 
-    // make sure king would not be in check in intermediate position
-    brd[4 - rowStep][col] = brd[4][col];
-    brd[4][col] = (PIECE *) 0;
-    findBestMoves(1, OtherColor(color), metric, (BESTMOVES *) 0);
-    brd[4][col] = brd[4 - rowStep][col];
-    brd[4 - rowStep][col] = (PIECE *) 0;
-
-    return(metric.kingSituation[color] == KINGOK);
+    // make sure king would not be in check in intermediate position,
+    // where it would no longer block its initial position
+    return(!attackers(POSITION(4 - rowStep, col), OtherColor(color),
+                      occupied() ^ PositionBit(POSITION(4, col))));
   }
 
 void BOARD::castle
@@ -366,8 +952,15 @@ void BOARD::castle
   {
     int col = color == WHITE ? 0 : 7;
 
+    undoData.saveHashKey = hashKey;
+    hashKey ^= enPassantKey() ^ ZobristKeys.castle[castleRights()];
+
     if (whichCastle == QUEENSIDECASTLE)
       {
+        flipPiece(brd[0][col], POSITION(0, col));
+        flipPiece(brd[0][col], POSITION(3, col));
+        flipPiece(brd[4][col], POSITION(4, col));
+        flipPiece(brd[4][col], POSITION(2, col));
         brd[3][col] = brd[0][col];
         brd[2][col] = brd[4][col];
         brd[0][col] = (PIECE *) 0;
@@ -377,6 +970,10 @@ void BOARD::castle
       }
     else
       {
+        flipPiece(brd[7][col], POSITION(7, col));
+        flipPiece(brd[7][col], POSITION(5, col));
+        flipPiece(brd[4][col], POSITION(4, col));
+        flipPiece(brd[4][col], POSITION(6, col));
         brd[5][col] = brd[7][col];
         brd[6][col] = brd[4][col];
         brd[7][col] = (PIECE *) 0;
@@ -394,6 +991,7 @@ void BOARD::castle
     else
       undoData.enPassantEffect = OTHERMOVE;
 
+    hashKey ^= ZobristKeys.castle[castleRights()];
 
     return;
   }
@@ -407,8 +1005,14 @@ void BOARD::undoCastle
   {
     int col = color == WHITE ? 0 : 7;
 
+    // the hash key is restored below, only the position sets need
+    // to be changed back
     if (whichCastle == QUEENSIDECASTLE)
       {
+        flipPiece(brd[3][col], POSITION(3, col));
+        flipPiece(brd[3][col], POSITION(0, col));
+        flipPiece(brd[2][col], POSITION(2, col));
+        flipPiece(brd[2][col], POSITION(4, col));
         brd[0][col] = brd[3][col];
         brd[4][col] = brd[2][col];
         brd[3][col] = (PIECE *) 0;
@@ -418,6 +1022,10 @@ void BOARD::undoCastle
       }
     else
       {
+        flipPiece(brd[5][col], POSITION(5, col));
+        flipPiece(brd[5][col], POSITION(7, col));
+        flipPiece(brd[6][col], POSITION(6, col));
+        flipPiece(brd[6][col], POSITION(4, col));
         brd[7][col] = brd[5][col];
         brd[4][col] = brd[6][col];
         brd[5][col] = (PIECE *) 0;
@@ -434,6 +1042,8 @@ void BOARD::undoCastle
     else
       wasLastMoveDoublePawn = FALSE;
 
+    hashKey = undoData.saveHashKey;
+
     return;
   }
 
@@ -452,13 +1062,17 @@ BOOL BOARD::canPromote(POSITION where)
 
 void BOARD::promote(POSITION where, PIECETYPE promoteType)
   {
+    flipPiece(whatPiece(where), where);
     ((PAWN *) whatPiece(where))->promote(promoteType);
+    flipPiece(whatPiece(where), where);
     return;
   }
 
 void BOARD::restorePawn(POSITION where)
   {
+    flipPiece(whatPiece(where), where);
     ((PAWN *) whatPiece(where))->restoreToPawn();
+    flipPiece(whatPiece(where), where);
     return;
   }
 
@@ -470,9 +1084,8 @@ MOVESTATUS BOARD::doUserMove
   {
     PIECE *p = whatPiece(start.row, start.col);
     POSITIONLIST moves;
-    BOARDMETRIC metric;
-    BESTMOVES bestMoves;
     MOVEUNDODATA undoData;
+    BITBOARD danger;
     int m;
 
     if (!p)
@@ -490,12 +1103,11 @@ MOVESTATUS BOARD::doUserMove
 
     doMove(start, end, undoData);
 
-    findBestMoves(1, OtherColor(p->whatColor()), metric, &bestMoves);
-
-    if (metric.kingSituation[p->whatColor()] == KINGLOST)
+    danger = attackers(whereKing(p->whatColor()), OtherColor(p->whatColor()));
+    if (danger)
       {
         undoMove(end, start, undoData);
-        return(MOVESTATUS(WOULDLOSEKING, bestMoves.move[0].start));
+        return(MOVESTATUS(WOULDLOSEKING, FirstPosition(danger)));
       }
 
     if (undoData.capturedPiece)
@@ -510,22 +1122,34 @@ BOOL BOARD::userCanCastle
   (
     MOVETYPE whichCastle,
     PIECECOLOR color
-  )
+  ) const
   {
-    BOARDMETRIC metric;
-    MOVEUNDODATA undoData;
+    int col = color == WHITE ? 0 : 7;
+    int kingRow, rookRow, rookEndRow;
 
     if (!canCastle(whichCastle, color))
       return(FALSE);
 
-    castle(whichCastle, color, undoData);
-
-    // make sure king is not in check in final position
-    findBestMoves(1, OtherColor(color), metric, (BESTMOVES *) 0);
-
-    undoCastle(whichCastle, color, undoData);
+    if (whichCastle == QUEENSIDECASTLE)
+      {
+        kingRow = 2;
+        rookRow = 0;
+        rookEndRow = 3;
+      }
+    else
+      {
+        kingRow = 6;
+        rookRow = 7;
+        rookEndRow = 5;
+      }
 
-    return(metric.kingSituation[color] == KINGOK);
+    // make sure king would not be in check in final position, with
+    // the king and rook moved
+    return(!attackers(POSITION(kingRow, col), OtherColor(color),
+                      occupied() ^ PositionBit(POSITION(4, col)) ^
+                      PositionBit(POSITION(kingRow, col)) ^
+                      PositionBit(POSITION(rookRow, col)) ^
+                      PositionBit(POSITION(rookEndRow, col))));
   }
 
 
@@ -614,381 +1238,1292 @@ LOCAL int compareMetric
     return(compare);
   }
 
-void BOARD::helpFindBestMoves
+// returns TRUE if the player to move will get a metric at least as
+// good as the given one from the current position, and the opponent
+// prefers the best metric it had already found for some other move
+// into a position before the current one to any such metric.  the
+// opponent would never choose to move into the current position, so
+// the rest of the moves from it need not be examined.
+LOCAL BOOL refuted
   (
-    int lookAhead,
+    const BOARDMETRIC &metric,
     PIECECOLOR moveColor,
-    BOARDMETRIC &metric,
-    BESTMOVES *bestMoves
+    // the material change at the current position
+    int origMaterialDiff,
+    const BOARDMETRIC *opponentBest,
+    BOOL opponentKeepsTies
   )
   {
-    POSITION where;
-    POSITIONLIST moves;
-    BOARDMETRIC testMetric;
-    BOOL metricSet = FALSE;
-    MOVEUNDODATA undoData;
-    int m, compareResult;
-    int origMaterialDiff = metric.materialDiff;
-    MOVETYPE castleType;
+    PIECECOLOR otherColor = OtherColor(moveColor);
+    BOARDMETRIC kingTaken;
+    int compare;
 
-    testMetric.kingSituation[WHITE] = KINGOK;
-    testMetric.kingSituation[BLACK] = KINGOK;
+    if (!opponentBest)
+      return(FALSE);
 
-    // try all possible moves for the given color
+    // a move that takes the king ends the look-ahead with the material
+    // as it is at the current position, even if a metric that is better
+    // for the player to move has already been found.  if such a move
+    // might still be found, the player to move is only assured of the
+    // worse of the two metrics.
+    if (metric.kingSituation[otherColor] == KINGLOST)
+      {
+        kingTaken.kingSituation[moveColor] = KINGOK;
+        kingTaken.kingSituation[otherColor] = KINGLOST;
+        kingTaken.materialDiff = origMaterialDiff;
+        if (compareMetric(metric, kingTaken, TRUE, moveColor) > 0)
+          return(refuted(kingTaken, moveColor, origMaterialDiff,
+                         opponentBest, opponentKeepsTies));
+      }
 
-    for (where.row = 0; where.row < NUMROWS; where.row++)
-      for (where.col = 0; where.col < NUMCOLS; where.col++)
+    // both players rank a stalemate below any outcome where both kings
+    // are ok.  so even though a stalemate is not good for the player
+    // to move, the metric could still end up being one that the
+    // opponent prefers to its best.  the opponent can only be certain
+    // to prefer a metric where it takes the king.
+    if ((metric.kingSituation[WHITE] == STALEMATE) ||
+        (metric.kingSituation[BLACK] == STALEMATE))
+      return((opponentBest->kingSituation[moveColor] == KINGLOST) &&
+             (opponentBest->kingSituation[otherColor] == KINGOK));
+
+    compare = compareMetric(*opponentBest, metric, TRUE, otherColor);
+
+    return(opponentKeepsTies ? (compare > 0) : (compare >= 0));
+  }
+
+// compare the metric of a move just examined with the best found so
+// far for the current position, updating the best metric and the list
+// of best moves.  returns TRUE if the rest of the moves need not be
+// examined.
+LOCAL BOOL recordMove
+  (
+    // metric and description of the move examined
+    const BOARDMETRIC &testMetric,
+    const PIECEMOVE &move,
+    PIECECOLOR moveColor,
+    // the material change at the current position
+    int origMaterialDiff,
+    // best metric so far.  not valid if metricSet is FALSE.
+    BOARDMETRIC &metric,
+    BOOL &metricSet,
+    // if not null, list of moves with the best metric
+    BESTMOVES *bestMoves,
+    // as passed to helpFindBestMoves
+    const BOARDMETRIC *opponentBest,
+    BOOL opponentKeepsTies
+  )
+  {
+    int compareResult =
+      compareMetric(testMetric, metric, metricSet, moveColor);
+
+    if (compareResult < 0)
+      return(FALSE);
+
+    if (compareResult > 0)
+      {
+        metric = testMetric;
+        metricSet = TRUE;
+        if (bestMoves)
+          bestMoves->nMoves = 0;
+
+        if (refuted(metric, moveColor, origMaterialDiff, opponentBest,
+                    opponentKeepsTies))
+          return(TRUE);
+      }
+
+    if (bestMoves)
+      bestMoves->move[bestMoves->nMoves++] = move;
+
+    return(FALSE);
+  }
+
+// a score for a metric without a stalemate, from the point of view of
+// the given color.  higher scores are better for that color, and the
+// score for the other color is the negative.
+const int KINGSCORE = 10000;
+LOCAL int quiesceScore(const BOARDMETRIC &metric, PIECECOLOR color)
+  {
+    int score = color == WHITE ? metric.materialDiff : -metric.materialDiff;
+
+    if (metric.kingSituation[OtherColor(color)] == KINGLOST)
+      score += KINGSCORE;
+    else if (metric.kingSituation[color] == KINGLOST)
+      score -= KINGSCORE;
+
+    return(score);
+  }
+
+// convert a score from quiesceScore back to a metric
+LOCAL void scoreMetric(int score, PIECECOLOR color, BOARDMETRIC &metric)
+  {
+    metric.kingSituation[WHITE] = KINGOK;
+    metric.kingSituation[BLACK] = KINGOK;
+
+    if (score > (KINGSCORE / 2))
+      {
+        metric.kingSituation[OtherColor(color)] = KINGLOST;
+        score -= KINGSCORE;
+      }
+    else if (score < -(KINGSCORE / 2))
+      {
+        metric.kingSituation[color] = KINGLOST;
+        score += KINGSCORE;
+      }
+
+    metric.materialDiff = color == WHITE ? score : -score;
+
+    return;
+  }
+
+// transposition table, holding the results of look-ahead searches
+// of positions already examined.  the same position is often reached
+// by more than one order of moves, and the table also keeps results
+// from one move to the next.
+
+// kind of result stored in an entry
+enum TTBOUND
+  {
+    // metric found by examining all the moves
+    TTEXACT,
+    // search stopped early, the player to move can get a metric at
+    // least as good as the one stored
+    TTLOWER
+  };
+
+// the fields of an entry, other than the key, packed into one word
+class TTDATA
+  {
+  public:
+    // metric, with material change relative to the position
+    int materialDiff;
+    SITUATIONOFKING kingSituation[2];
+    // look-ahead of the search of the position.  0 if entry unused.
+    int lookAhead;
+    TTBOUND bound;
+    // value of ttAge when entry was stored
+    int age;
+
+    TTDATA(void) { }
+
+    // unpack
+    TTDATA(HASHKEY w)
+      {
+        materialDiff = (short) (w & 0xFFFF);
+        kingSituation[WHITE] = (SITUATIONOFKING) ((w >> 16) & 3);
+        kingSituation[BLACK] = (SITUATIONOFKING) ((w >> 18) & 3);
+        bound = (TTBOUND) ((w >> 20) & 1);
+        lookAhead = (int) ((w >> 24) & 0xFF);
+        age = (int) ((w >> 32) & 0xFF);
+      }
+
+    HASHKEY pack(void) const
+      {
+        return(((HASHKEY) (unsigned short) materialDiff) |
+               ((HASHKEY) kingSituation[WHITE] << 16) |
+               ((HASHKEY) kingSituation[BLACK] << 18) |
+               ((HASHKEY) bound << 20) |
+               ((HASHKEY) lookAhead << 24) |
+               ((HASHKEY) age << 32));
+      }
+  };
+
+// the table is shared by the threads searching in parallel, without
+// locking.  the key is stored exclusive or'ed with the data, so an
+// entry that is half written by one thread while another reads it
+// will not match the key.
+class TTENTRY
+  {
+  public:
+    // hash key of position (including color to move) ^ data
+    std::atomic<HASHKEY> check;
+    // packed TTDATA
+    std::atomic<HASHKEY> data;
+  };
+
+// number of entries in a bucket, sized so that a bucket fills one
+// cache line
+const int TTBUCKETENTRIES = 4;
+
+class alignas(TTBUCKETENTRIES * sizeof(TTENTRY)) TTBUCKET
+  {
+  public:
+    TTENTRY entry[TTBUCKETENTRIES];
+  };
+
+// number of buckets, must be a power of 2
+const int TTBUCKETS = 1 << 18;
+
+LOCAL TTBUCKET transTable[TTBUCKETS];
+
+// incremented for each new search, so that entries from old searches
+// are replaced first
+LOCAL unsigned char ttAge;
+
+// look for the result of a search of the position with the given key.
+// returns TRUE, with metric filled in, if the stored result can be
+// used in place of searching the position.
+LOCAL BOOL probeTransTable
+  (
+    HASHKEY key,
+    int lookAhead,
+    PIECECOLOR moveColor,
+    BOARDMETRIC &metric,
+    const BOARDMETRIC *opponentBest,
+    BOOL opponentKeepsTies
+  )
+  {
+    TTBUCKET &bucket = transTable[key & (TTBUCKETS - 1)];
+    BOARDMETRIC stored;
+    HASHKEY check, data;
+    int i;
+
+    for (i = 0; i < TTBUCKETENTRIES; i++)
+      {
+        check = bucket.entry[i].check.load(std::memory_order_relaxed);
+        data = bucket.entry[i].data.load(std::memory_order_relaxed);
+        if ((check ^ data) != key)
+          continue;
+
+        TTDATA e(data);
+
+        // results of searches with a different look-ahead are not used,
+        // so that the same moves are chosen as without the table
+        if (e.lookAhead == lookAhead)
+          {
+            stored.kingSituation[WHITE] = e.kingSituation[WHITE];
+            stored.kingSituation[BLACK] = e.kingSituation[BLACK];
+            stored.materialDiff = metric.materialDiff + e.materialDiff;
+
+            if ((e.bound == TTEXACT) ||
+                refuted(stored, moveColor, metric.materialDiff,
+                        opponentBest, opponentKeepsTies))
+              {
+                metric = stored;
+                return(TRUE);
+              }
+
+            return(FALSE);
+          }
+      }
+
+    return(FALSE);
+  }
+
+// store the result of a search of a position
+LOCAL void storeTransTable
+  (
+    HASHKEY key,
+    int lookAhead,
+    TTBOUND bound,
+    const BOARDMETRIC &metric,
+    // the material change at the position
+    int origMaterialDiff
+  )
+  {
+    TTBUCKET &bucket = transTable[key & (TTBUCKETS - 1)];
+    int i, score, bestScore = INT_MAX;
+    TTENTRY *e = 0;
+    HASHKEY check, data;
+    TTDATA d;
+
+    // replace the entry for the same search if there is one, otherwise
+    // the one with the least look-ahead, preferring old entries
+    for (i = 0; i < TTBUCKETENTRIES; i++)
+      {
+        check = bucket.entry[i].check.load(std::memory_order_relaxed);
+        data = bucket.entry[i].data.load(std::memory_order_relaxed);
+        d = TTDATA(data);
+
+        if (((check ^ data) == key) && (d.lookAhead == lookAhead))
+          {
+            e = bucket.entry + i;
+            break;
+          }
+
+        score = d.lookAhead;
+        if (d.age == ttAge)
+          score += 256;
+        if (score < bestScore)
+          {
+            e = bucket.entry + i;
+            bestScore = score;
+          }
+      }
+
+    d.materialDiff = metric.materialDiff - origMaterialDiff;
+    d.kingSituation[WHITE] = metric.kingSituation[WHITE];
+    d.kingSituation[BLACK] = metric.kingSituation[BLACK];
+    d.lookAhead = lookAhead;
+    d.bound = bound;
+    d.age = ttAge;
+    data = d.pack();
+
+    e->check.store(key ^ data, std::memory_order_relaxed);
+    e->data.store(data, std::memory_order_relaxed);
+
+    return;
+  }
+
+// number of positions examined between checks of the clock (when
+// there is a deadline for the search) and of StopSearches
+const int CLOCKCHECKINTERVAL = 1000;
+
+// the types to which a pawn is promoted when looking ahead.  a queen
+// can make any move a rook or bishop can, so only a knight might be
+// a better choice.
+LOCAL const PIECETYPE lookAheadPromoteType[] = { TYPEQUEEN, TYPEKNIGHT };
+
+// value of a piece when ordering captures by the least valuable
+// attacker.  the king is worth the most, since it can only capture
+// pieces that are not protected.
+LOCAL inline int attackerValue(const PIECE *p)
+  {
+    return(p->whatType() == TYPEKING ? VALUEQUEEN + VALUEPAWN :
+                                       p->whatValue());
+  }
+
+void BOARD::listMoves
+  (
+    PIECECOLOR moveColor,
+    MOVELIST &list,
+    BOOL capturesOnly
+  ) const
+  {
+    // only set by lastMoveDoublePawn if the last move was one
+    POSITION where, doubleMoved(0, 0);
+    POSITIONLIST moves;
+    const PIECE *piece, *victim;
+    int m, p, i, score, moveScore, nPromote;
+    BOOL enPassant = lastMoveDoublePawn(doubleMoved);
+    int lastCol = moveColor == WHITE ? (NUMCOLS - 1) : 0;
+    PIECEMOVE move;
+    PIECECOLOR other = OtherColor(moveColor);
+    POSITION king = whereKing(moveColor);
+    BITBOARD pieces = whatPieces(moveColor);
+    BITBOARD enemies = whatPieces(other);
+    BITBOARD evasions, pinned, allowed, endBit;
+    BITBOARD pinRay[NUMROWS * NUMCOLS];
+
+    list.nMoves = 0;
+
+    findPins(moveColor, evasions, pinned, pinRay);
+
+    for ( ; pieces; pieces = RemoveFirst(pieces))
+      {
+        where = FirstPosition(pieces);
+        piece = whatPiece(where);
+
+        // the positions a piece other than the king can move to
+        // without leaving its king in check
+        allowed = evasions;
+        if (pinned & PositionBit(where))
+          allowed &= pinRay[PositionIndex(where)];
+        if (!allowed && (piece->whatType() != TYPEKING))
+          continue;
+
+        piece->legalMoves(where, *this, moves);
+        for (m = 0; m < moves.nMoves; m++)
+          {
+            endBit = PositionBit(moves.end[m]);
+            victim = (enemies & endBit) ?
+                     whatPiece(moves.end[m]) : (const PIECE *) 0;
+            nPromote = 1;
+            if (piece->whatType() == TYPEKING)
+              {
+                // the king can't move where it could be taken, even
+                // along the line of a piece it no longer blocks
+                if (attackers(moves.end[m], other,
+                              occupied() ^ PositionBit(where)))
+                  continue;
+              }
+            else if ((piece->whatType() == TYPEPAWN) && !victim &&
+                     enPassant && (moves.end[m].row != where.row))
+              {
+                // en passant capture.  two positions on the row of
+                // the king may be emptied, so check the position
+                // after the move.
+                victim = whatPiece(doubleMoved);
+                if (attackers(king, other,
+                              occupied() ^ PositionBit(where) ^ endBit ^
+                              PositionBit(doubleMoved)) &
+                    ~PositionBit(doubleMoved))
+                  continue;
+              }
+            else if (!(allowed & endBit))
+              continue;
+
+            if ((piece->whatType() == TYPEPAWN) &&
+                (moves.end[m].col == lastCol))
+              nPromote = ARRAY_LENGTH(lookAheadPromoteType);
+
+            if (!victim)
+              {
+                if (capturesOnly && (nPromote == 1))
+                  continue;
+                score = 0;
+              }
+            else
+              score = VALUEQUEEN + (victim->whatValue() * VALUEQUEEN) -
+                      attackerValue(piece);
+
+            for (p = 0; p < nPromote; p++)
+              {
+                move = PIECEMOVE
+                         (
+                           NORMALMOVE,
+                           where,
+                           moves.end[m],
+                           nPromote > 1 ? lookAheadPromoteType[p] :
+                                          TYPENOPIECE
+                         );
+
+                moveScore = score;
+                if (nPromote > 1)
+                  moveScore += (2 * VALUEQUEEN * VALUEQUEEN) -
+                               (p * VALUEQUEEN);
+
+                // insert move after all moves with at least as high
+                // a score
+                i = list.nMoves++;
+                while ((i > 0) && (list.score[i - 1] < moveScore))
+                  {
+                    list.move[i] = list.move[i - 1];
+                    list.score[i] = list.score[i - 1];
+                    i--;
+                  }
+                list.move[i] = move;
+                list.score[i] = moveScore;
+              }
+          }
+      }
+
+    return;
+  }
+
+// set by StopSearches
+LOCAL std::atomic<bool> searchesStopped(false);
+
+void StopSearches(BOOL stop)
+  {
+    searchesStopped.store(stop, std::memory_order_relaxed);
+
+    return;
+  }
+
+BOOL BOARD::pastDeadline(void)
+  {
+    if (--untilClockCheck < 0)
+      {
+        untilClockCheck = CLOCKCHECKINTERVAL;
+        if (searchesStopped.load(std::memory_order_relaxed) ||
+            (deadline && (ClockNow() >= deadline)))
+          searchAbandoned = TRUE;
+      }
+
+    return(searchAbandoned);
+  }
+
+int BOARD::quiesce
+  (
+    PIECECOLOR moveColor,
+    int standPat,
+    int alpha,
+    int beta
+  )
+  {
+    MOVELIST moves;
+    MOVEUNDODATA undoData;
+    int m, gain, score, best = standPat;
+
+    if (pastDeadline())
+      return(best);
+
+    if (best >= beta)
+      return(best);
+    if (best > alpha)
+      alpha = best;
+
+    listMoves(moveColor, moves, TRUE);
+
+    for (m = 0; m < moves.nMoves; m++)
+      {
+        const PIECEMOVE &move = moves.move[m];
+
+        doMove(move.start, move.end, undoData);
+        stats.quiesceNodes++;
+
+        gain = 0;
+        if (undoData.capturedPiece)
+          gain = undoData.capturedPiece->whatValue();
+
+        if (move.promoteType != TYPENOPIECE)
+          {
+            stats.promotions++;
+            gain -= whatPiece(move.end)->whatValue();
+            promote(move.end, move.promoteType);
+            gain += whatPiece(move.end)->whatValue();
+          }
+
+        score = -quiesce(OtherColor(moveColor), -(standPat + gain), -beta,
+                         -alpha);
+
+        if (move.promoteType != TYPENOPIECE)
+          restorePawn(move.end);
+
+        undoMove(move.end, move.start, undoData);
+
+        if (searchAbandoned)
+          return(best);
+
+        if (score > best)
+          {
+            best = score;
+            if (best >= beta)
+              return(best);
+            if (best > alpha)
+              alpha = best;
+          }
+      }
+
+    return(best);
+  }
+
+void BOARD::quiesceMetric
+  (
+    PIECECOLOR moveColor,
+    BOARDMETRIC &metric,
+    const BOARDMETRIC *opponentBest,
+    BOOL opponentKeepsTies
+  )
+  {
+    int beta = INT_MAX;
+
+    // the opponent's best metric came from the same kind of search,
+    // so it can't be a stalemate
+    if (opponentBest)
+      {
+        beta = -quiesceScore(*opponentBest, OtherColor(moveColor));
+        if (opponentKeepsTies)
+          beta++;
+      }
+
+    scoreMetric
+      (
+        quiesce(moveColor, quiesceScore(metric, moveColor), -INT_MAX, beta),
+        moveColor,
+        metric
+      );
+
+    return;
+  }
+
+void BOARD::lookAheadMove
+  (
+    const PIECEMOVE &move,
+    int lookAhead,
+    PIECECOLOR moveColor,
+    BOARDMETRIC &testMetric,
+    const BOARDMETRIC *best,
+    BOOL keepTies,
+    BOOL quiesceLeaves
+  )
+  {
+    MOVEUNDODATA undoData;
+
+    int ply = stats.lookAhead - lookAhead;
+
+    testMetric.kingSituation[WHITE] = KINGOK;
+    testMetric.kingSituation[BLACK] = KINGOK;
+
+    stats.nodes[ply < MAXSTATSLOOKAHEAD ? ply : (MAXSTATSLOOKAHEAD - 1)]++;
+    if (lookAhead == 1)
+      stats.leaves++;
+
+    if (move.type != NORMALMOVE)
+      {
+        stats.castles++;
+        castle(move.type, moveColor, undoData);
+      }
+    else
+      {
+        doMove(move.start, move.end, undoData);
+
+        if (undoData.capturedPiece)
+          testMetric.materialDiff -= undoData.capturedPiece->signedValue();
+
+        if (move.promoteType != TYPENOPIECE)
+          {
+            stats.promotions++;
+            testMetric.materialDiff -= whatPiece(move.end)->signedValue();
+            promote(move.end, move.promoteType);
+            testMetric.materialDiff += whatPiece(move.end)->signedValue();
+          }
+      }
+
+    if (lookAhead > 1)
+      helpFindBestMoves
+        (
+          lookAhead - 1,
+          OtherColor(moveColor),
+          testMetric,
+          (BESTMOVES *) 0,
+          best,
+          keepTies,
+          quiesceLeaves
+        );
+    else if (quiesceLeaves)
+      quiesceMetric(OtherColor(moveColor), testMetric, best, keepTies);
+
+    if (move.type != NORMALMOVE)
+      undoCastle(move.type, moveColor, undoData);
+    else
+      {
+        if (move.promoteType != TYPENOPIECE)
+          restorePawn(move.end);
+
+        undoMove(move.end, move.start, undoData);
+      }
+
+    return;
+  }
+
+// state shared by the threads searching the first moves of a
+// look-ahead in parallel
+class ROOTSPLIT
+  {
+  public:
+    // the board each thread copies
+    const BOARD *board;
+    // parameters of the search
+    int lookAhead;
+    PIECECOLOR moveColor;
+    int origMaterialDiff;
+    BOOL quiesceLeaves;
+    // the moves to search, including castling moves
+    MOVELIST moves;
+    // index in moves of the next move for a thread to search
+    std::atomic<int> nextMove;
+
+    // locks the rest of the members
+    std::mutex mutex;
+    // best metric found so far.  not valid if metricSet is FALSE.
+    BOARDMETRIC metric;
+    BOOL metricSet;
+    // indexes in moves of the moves with the best metric
+    int nBest;
+    int best[MAXPIECES * MAXMOVES];
+    // set if any thread abandoned its search
+    BOOL abandoned;
+    // totals of the statistics of the threads
+    SEARCHSTATS stats;
+  };
+
+void BOARD::splitJob(void *arg, int /* thread */)
+  {
+    ROOTSPLIT &split = *(ROOTSPLIT *) arg;
+    BOARD board(*split.board);
+
+    board.searchSplit(split);
+
+    std::lock_guard<std::mutex> lock(split.mutex);
+    split.stats.add(board.stats);
+
+    return;
+  }
+
+void BOARD::searchSplit(ROOTSPLIT &split)
+  {
+    BOARDMETRIC testMetric, best;
+    BOOL bestSet;
+    int m, compareResult;
+
+    for ( ; ; )
+      {
+        m = split.nextMove++;
+        if (m >= split.moves.nMoves)
+          break;
+
+        {
+          std::lock_guard<std::mutex> lock(split.mutex);
+          bestSet = split.metricSet;
+          best = split.metric;
+        }
+
+        testMetric.materialDiff = split.origMaterialDiff;
+        lookAheadMove(split.moves.move[m], split.lookAhead, split.moveColor,
+                      testMetric, bestSet ? &best : (BOARDMETRIC *) 0, TRUE,
+                      split.quiesceLeaves);
+
+        std::lock_guard<std::mutex> lock(split.mutex);
+
+        if (searchAbandoned)
+          {
+            split.abandoned = TRUE;
+            break;
+          }
+
+        // the same as recordMove, for the first move of a look-ahead
+        compareResult = compareMetric(testMetric, split.metric,
+                                      split.metricSet, split.moveColor);
+        if (compareResult > 0)
+          {
+            split.metric = testMetric;
+            split.metricSet = TRUE;
+            split.nBest = 0;
+          }
+        if (compareResult >= 0)
+          split.best[split.nBest++] = m;
+      }
+
+    return;
+  }
+
+void SEARCHSTATS::clear(void)
+  {
+    int i;
+
+    lookAhead = 0;
+    for (i = 0; i < MAXSTATSLOOKAHEAD; i++)
+      nodes[i] = 0;
+    leaves = 0;
+    quiesceNodes = 0;
+    promotions = 0;
+    castles = 0;
+    tableHits = 0;
+    time = 0;
+    abandoned = FALSE;
+
+    return;
+  }
+
+void SEARCHSTATS::add(const SEARCHSTATS &s)
+  {
+    int i;
+
+    for (i = 0; i < MAXSTATSLOOKAHEAD; i++)
+      nodes[i] += s.nodes[i];
+    leaves += s.leaves;
+    quiesceNodes += s.quiesceNodes;
+    promotions += s.promotions;
+    castles += s.castles;
+    tableHits += s.tableHits;
+
+    return;
+  }
+
+unsigned long long SEARCHSTATS::total(void) const
+  {
+    unsigned long long t = quiesceNodes;
+    int i;
+
+    for (i = 0; i < MAXSTATSLOOKAHEAD; i++)
+      t += nodes[i];
+
+    return(t);
+  }
+
+double SEARCHSTATS::branchingFactor(void) const
+  {
+    if (lookAhead < 1)
+      return(0.0);
+
+    return(pow((double) total(), 1.0 / lookAhead));
+  }
+
+void BOARD::findBestMoves
+  (
+    int lookAhead,
+    PIECECOLOR moveColor,
+    BOARDMETRIC &metric,
+    BESTMOVES *bestMoves,
+    BOOL quiesceLeaves
+  )
+  {
+    CLOCKTIME start = ClockNow();
+
+    metric.materialDiff = 0;
+    stats.clear();
+    stats.lookAhead = lookAhead;
+
+    helpFindBestMoves(lookAhead, moveColor, metric, bestMoves,
+                      (BOARDMETRIC *) 0, FALSE, quiesceLeaves);
+
+    stats.time = ClockNow() - start;
+    stats.abandoned = searchAbandoned;
+
+    return;
+  }
+
+void BOARD::helpFindBestMoves
+  (
+    int lookAhead,
+    PIECECOLOR moveColor,
+    BOARDMETRIC &metric,
+    BESTMOVES *bestMoves,
+    const BOARDMETRIC *opponentBest,
+    BOOL opponentKeepsTies,
+    BOOL quiesceLeaves
+  )
+  {
+    MOVELIST moves;
+    BOARDMETRIC testMetric;
+    BOOL metricSet = FALSE;
+    int m, i, j;
+    int origMaterialDiff = metric.materialDiff;
+    MOVETYPE castleType;
+    ROOTSPLIT *split;
+    // the table is not used for the first move, since the list of
+    // best moves is needed
+    BOOL useTable = !bestMoves;
+    HASHKEY key = whatHashKey(moveColor);
+
+    if (quiesceLeaves)
+      key ^= ZobristKeys.quiesceLeaves;
+
+    if (pastDeadline())
+      return;
+
+    if (bestMoves)
+      ttAge++;
+    else if (useTable)
+      if (probeTransTable(key, lookAhead, moveColor, metric, opponentBest,
+                          opponentKeepsTies))
         {
-          if (whatPiece(where))
-            if (whatPiece(where)->whatColor() == moveColor)
-              {
-                whatPiece(where)->legalMoves(where, *this, moves);
-                for (m = 0; m < moves.nMoves; m++)
-                  {
-                    testMetric.materialDiff = origMaterialDiff;
-                    doMove
-                      (
-                        where,
-                        moves.end[m],
-                        undoData
-                      );
-
-                    if (undoData.capturedPiece)
-                      {
-                        if (undoData.capturedPiece->whatType() == TYPEKING)
-                          {
-                            undoMove
-                              (
-                                moves.end[m],
-                                where,
-                                undoData
-                              );
-
-                            metric.kingSituation[OtherColor(moveColor)] =
-                              KINGLOST;
-
-                            if (bestMoves)
-                              {
-                                bestMoves->nMoves = 0;
-                                bestMoves->move[0] =
-                                  PIECEMOVE
-                                    (
-                                      NORMALMOVE,
-                                      where,
-                                      moves.end[m]
-                                    );
-                              }
-
-                            return;
-                          }
-                        testMetric.materialDiff -=
-                          undoData.capturedPiece->signedValue();
-                      }
-
-                    if (canPromote(moves.end[m]))
-                      {
-                        testMetric.materialDiff -=
-                          whatPiece(moves.end[m])->signedValue();
-                        promote(moves.end[m], TYPEQUEEN);
-                        testMetric.materialDiff +=
-                          whatPiece(moves.end[m])->signedValue();
-                        if (lookAhead > 1)
-                          helpFindBestMoves
-                            (
-                              lookAhead - 1,
-                              OtherColor(moveColor),
-                              testMetric,
-                              (BESTMOVES *) 0
-                            );
-                        compareResult = compareMetric
-                                          (
-                                            testMetric,
-                                            metric,
-                                            metricSet,
-                                            moveColor
-                                          );
-                        if (compareResult >= 0)
-                          {
-                            if (compareResult > 0)
-                              {
-                                metric = testMetric;
-                                metricSet = TRUE;
-                                if (bestMoves)
-                                  bestMoves->nMoves = 0;
-                              }
-                            if (bestMoves)
-                              bestMoves->move[bestMoves->nMoves++] =
-                                PIECEMOVE
-                                  (
-                                    NORMALMOVE,
-                                    where,
-                                    moves.end[m],
-                                    TYPEQUEEN
-                                  );
-                          }
-                        testMetric.materialDiff -=
-                          whatPiece(moves.end[m])->signedValue();
-                        restorePawn(moves.end[m]);
-
-                        promote(moves.end[m], TYPEKNIGHT);
-                        testMetric.materialDiff +=
-                          whatPiece(moves.end[m])->signedValue();
-                        if (lookAhead > 1)
-                          helpFindBestMoves
-                            (
-                              lookAhead - 1,
-                              OtherColor(moveColor),
-                              testMetric,
-                              (BESTMOVES *) 0
-                            );
-                        compareResult = compareMetric
-                                          (
-                                            testMetric,
-                                            metric,
-                                            metricSet,
-                                            moveColor
-                                          );
-                        if (compareResult >= 0)
-                          {
-                            if (compareResult > 0)
-                              {
-                                metric = testMetric;
-                                metricSet = TRUE;
-                                if (bestMoves)
-                                  bestMoves->nMoves = 0;
-                              }
-                            if (bestMoves)
-                              bestMoves->move[bestMoves->nMoves++] =
-                                PIECEMOVE
-                                  (
-                                    NORMALMOVE,
-                                    where,
-                                    moves.end[m],
-                                    TYPEKNIGHT
-                                  );
-                          }
-                        restorePawn(moves.end[m]);
-                      }
-                    else // no promotion
-                      {
-                        if (lookAhead > 1)
-                          helpFindBestMoves
-                            (
-                              lookAhead - 1,
-                              OtherColor(moveColor),
-                              testMetric,
-                              (BESTMOVES *) 0
-                            );
-                        compareResult = compareMetric
-                                          (
-                                            testMetric,
-                                            metric,
-                                            metricSet,
-                                            moveColor
-                                           );
-                        if (compareResult >= 0)
-                          {
-                            if (compareResult > 0)
-                              {
-                                metric = testMetric;
-                                metricSet = TRUE;
-                                if (bestMoves)
-                                  bestMoves->nMoves = 0;
-                              }
-                            if (bestMoves)
-                              bestMoves->move[bestMoves->nMoves++] =
-                                PIECEMOVE
-                                  (
-                                    NORMALMOVE,
-                                    where,
-                                    moves.end[m]
-                                  );
-                          }
-                      }
-
-                    undoMove
-                      (
-                        moves.end[m],
-                        where,
-                        undoData
-                      );
-
-                  } // end of for loop over each legal move for piece
+          stats.tableHits++;
+          return;
+        }
 
-              }
+    metric.kingSituation[WHITE] = KINGOK;
+    metric.kingSituation[BLACK] = KINGOK;
+
+    // try all possible moves for the given color
 
-        } // end of double for loop over each board position
+    listMoves(moveColor, moves, FALSE);
 
-    // only try castling moves if look ahead move than one, since
-    // nothing can be captured by doing a castling move
-    if (lookAhead > 1)
+    if (bestMoves && (SearchThreads.howManyThreads() > 1) &&
+        (moves.nMoves > 0))
+      {
+        // search the first moves in parallel
+        if (!(split = new ROOTSPLIT))
+          OutOfMemory();
+
+        split->board = this;
+        split->lookAhead = lookAhead;
+        split->moveColor = moveColor;
+        split->origMaterialDiff = origMaterialDiff;
+        split->quiesceLeaves = quiesceLeaves;
+        split->moves = moves;
+        if (userCanCastle(QUEENSIDECASTLE, moveColor))
+          split->moves.move[split->moves.nMoves++] =
+            PIECEMOVE(QUEENSIDECASTLE);
+        if (userCanCastle(KINGSIDECASTLE, moveColor))
+          split->moves.move[split->moves.nMoves++] =
+            PIECEMOVE(KINGSIDECASTLE);
+        split->nextMove = 0;
+        split->metricSet = FALSE;
+        split->nBest = 0;
+        split->abandoned = searchAbandoned;
+        split->stats.clear();
+
+        if (!split->abandoned)
+          SearchThreads.run(splitJob, split);
+        stats.add(split->stats);
+
+        if (split->abandoned)
+          {
+            searchAbandoned = TRUE;
+            delete split;
+            return;
+          }
+
+        if (split->metricSet)
+          metric = split->metric;
+        metricSet = split->metricSet;
+
+        // put the best moves in the order they were listed, the same
+        // as when searching without other threads
+        for (i = 1; i < split->nBest; i++)
+          for (j = i; (j > 0) && (split->best[j - 1] > split->best[j]); j--)
+            {
+              m = split->best[j];
+              split->best[j] = split->best[j - 1];
+              split->best[j - 1] = m;
+            }
+
+        bestMoves->nMoves = split->nBest;
+        for (i = 0; i < split->nBest; i++)
+          bestMoves->move[i] = split->moves.move[split->best[i]];
+
+        delete split;
+      }
+    else
       {
+        for (m = 0; m < moves.nMoves; m++)
+          {
+            testMetric.materialDiff = origMaterialDiff;
+            lookAheadMove(moves.move[m], lookAhead, moveColor, testMetric,
+                          metricSet ? &metric : (BOARDMETRIC *) 0,
+                          bestMoves != (BESTMOVES *) 0, quiesceLeaves);
+
+            if (searchAbandoned)
+              return;
+
+            if (recordMove(testMetric, moves.move[m], moveColor,
+                           origMaterialDiff, metric, metricSet, bestMoves,
+                           opponentBest, opponentKeepsTies))
+              {
+                if (useTable)
+                  storeTransTable(key, lookAhead, TTLOWER, metric,
+                                  origMaterialDiff);
+                return;
+              }
+          }
+
         castleType = QUEENSIDECASTLE;
         for ( ; ; )
           {
-            if (canCastle(castleType, moveColor))
+            if (userCanCastle(castleType, moveColor))
               {
                 testMetric.materialDiff = origMaterialDiff;
-                castle(castleType, moveColor, undoData);
-                helpFindBestMoves
-                  (
-                    lookAhead - 1,
-                    OtherColor(moveColor),
-                    testMetric,
-                    (BESTMOVES *) 0
-                  );
-                compareResult = compareMetric
-                                  (
-                                    testMetric,
-                                    metric,
-                                    metricSet,
-                                    moveColor
-                                  );
-                if (compareResult >= 0)
+                lookAheadMove(PIECEMOVE(castleType), lookAhead,
+                              moveColor, testMetric,
+                              metricSet ? &metric : (BOARDMETRIC *) 0,
+                              bestMoves != (BESTMOVES *) 0,
+                              quiesceLeaves);
+
+                if (searchAbandoned)
+                  return;
+
+                if (recordMove(testMetric, PIECEMOVE(castleType),
+                               moveColor, origMaterialDiff, metric,
+                               metricSet, bestMoves, opponentBest,
+                               opponentKeepsTies))
                   {
-                    if (compareResult > 0)
-                      {
-                        metric = testMetric;
-                        metricSet = TRUE;
-                        if (bestMoves)
-                          bestMoves->nMoves = 0;
-                      }
-                    if (bestMoves)
-                      bestMoves->move[bestMoves->nMoves++] =
-                        PIECEMOVE(castleType);
+                    if (useTable)
+                      storeTransTable(key, lookAhead, TTLOWER, metric,
+                                      origMaterialDiff);
+                    return;
                   }
-                undoCastle(castleType, moveColor, undoData);
               }
             if (castleType == KINGSIDECASTLE)
               break;
             castleType = KINGSIDECASTLE;
           }
-
-        // see if the loss of the king is the result of a stalemate
-        // instead of check mate
-        if (metric.kingSituation[moveColor] == KINGLOST)
-          {
-            helpFindBestMoves
-              (
-                1,
-                OtherColor(moveColor),
-                testMetric,
-                (BESTMOVES *) 0
-              );
-            if (testMetric.kingSituation[moveColor] != KINGLOST)
-              // king will be lost on next move, but is not in check
-              metric.kingSituation[moveColor] = STALEMATE;
-          }
       }
 
+    // only legal moves are tried, so a king is never taken.  if there
+    // are no legal moves, the player is check mated or stale mated.
+    if (!metricSet)
+      metric.kingSituation[moveColor] =
+        inCheck(moveColor) ? KINGLOST : STALEMATE;
+
+    if (useTable)
+      storeTransTable(key, lookAhead, TTEXACT, metric, origMaterialDiff);
+
     return;
   }
 
-// list all legal horizontal moves in one direction from a given starting
-// point
-LOCAL void horzMoves
-  (
-    int row,
-    int col,
-    int delta,
-    const BOARD &board,
-    POSITIONLIST &moves
-  )
+// the directions in which sliding pieces move, in the order in which
+// their moves are listed.  the first four are the rook's, the last
+// four the bishop's.  a queen moves in all of them.
+LOCAL const class
   {
-    int limit = delta == 1 ? NUMCOLS : -1;
-    PIECECOLOR color = board.whatPiece(row, col)->whatColor();
+  public:
+    int row, col;
+  }
+slideDirection[] =
+  { { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 },
+    { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+const int nSlideDirections = ARRAY_LENGTH(slideDirection);
+const int FIRSTBISHOPDIRECTION = 4;
+
+// number of positions on the board, and so bits in a BITBOARD
+const int NUMPOSITIONS = NUMROWS * NUMCOLS;
+
+// magic numbers for the straight (rook) and diagonal (bishop) moves
+// from each starting position (see SLIDEATTACKS).  these were found by
+// trying random numbers with few bits set until one gave no two
+// patterns of blocking pieces with different reachable sets the same
+// index.
+LOCAL const BITBOARD rookMagic[NUMPOSITIONS] =
+  {
+    0xA080001820400080ULL, 0x0040002000401000ULL, 0x0180300160008008ULL,
+    0x0480040800801001ULL, 0x2A00081084204200ULL, 0x0480018012003400ULL,
+    0x0600010082000428ULL, 0x420002250C018042ULL, 0x0040800040002080ULL,
+    0x000040002000500CULL, 0x2002004022001080ULL, 0x0026002200400810ULL,
+    0x2000808008000400ULL, 0x0022000200883104ULL, 0x2C88808001000200ULL,
+    0x1112000080420104ULL, 0x0100908000400020ULL, 0x0080808020004000ULL,
+    0x0008410010200300ULL, 0x0014808010000801ULL, 0x0080050011004800ULL,
+    0x00D1010002080400ULL, 0xA08004000A300158ULL, 0x1000120005288244ULL,
+    0x020C400080248002ULL, 0x4020411200220082ULL, 0x8028100080200881ULL,
+    0x1210001100090020ULL, 0x005A005200084520ULL, 0x0080040080020080ULL,
+    0x0002000200840148ULL, 0x440B210A00006884ULL, 0x0880401028800080ULL,
+    0x2000802008804000ULL, 0x2160001041002900ULL, 0x201020400A001200ULL,
+    0x8018010009001104ULL, 0x2480800400800200ULL, 0x0000010804000210ULL,
+    0x0020008042003104ULL, 0x0000802040008000ULL, 0x0010002000404000ULL,
+    0x0001001020010041ULL, 0x8840100009010022ULL, 0x8048004020040400ULL,
+    0x2000040002008080ULL, 0x0803000200010084ULL, 0x0010004400820001ULL,
+    0xA881410720800100ULL, 0x0008208A00450600ULL, 0x0000802000100080ULL,
+    0x004408A240920200ULL, 0x6000800400080080ULL, 0x0020040002008080ULL,
+    0x8003000A00245500ULL, 0x0100842081004200ULL, 0x0000201840820102ULL,
+    0x0011002040008019ULL, 0x001181C20020501AULL, 0x1C10014488201101ULL,
+    0x0002002004110802ULL, 0x0881000204000801ULL, 0x2000880142100094ULL,
+    0x000154050022C082ULL
+  };
 
-    for ( ; ; )
+LOCAL const BITBOARD bishopMagic[NUMPOSITIONS] =
+  {
+    0x0060040410840210ULL, 0x4402080210860000ULL, 0x0004012C010000E8ULL,
+    0x0004410023014480ULL, 0x0001114000000009ULL, 0x8111012010008002ULL,
+    0x0241042120E80000ULL, 0x0484240208240280ULL, 0x4002400448088520ULL,
+    0x4010020408060448ULL, 0x0048080809102000ULL, 0xA940890401060208ULL,
+    0x0080040420124000ULL, 0x1020020210044040ULL, 0xC882008090101010ULL,
+    0x0108190448042400ULL, 0x001102200481080BULL, 0x0010804254010C08ULL,
+    0x1608084046004210ULL, 0x1018001501410002ULL, 0x0084001280A02020ULL,
+    0x0212003900610420ULL, 0x0001002044026010ULL, 0x6006080080410800ULL,
+    0x0850041A40251401ULL, 0x94082430A3102200ULL, 0x0408110012040900ULL,
+    0x6310040000440008ULL, 0x011003004A200800ULL, 0x8C00848018080440ULL,
+    0x0494410004010148ULL, 0x0008510140840100ULL, 0x032A202002121200ULL,
+    0x010221100004B020ULL, 0x4000820100408408ULL, 0x4AC0200501080108ULL,
+    0x2120208400808020ULL, 0x0A02080200204050ULL, 0x00900200A0820080ULL,
+    0x00C500410A520303ULL, 0x8481086004221200ULL, 0x8080880818002300ULL,
+    0x0020209150001800ULL, 0x0014044208000080ULL, 0x8A00200200800410ULL,
+    0x88A204480200A088ULL, 0x0014514801018200ULL, 0x00A200E401000080ULL,
+    0x8081069050A88000ULL, 0x01020201018808DCULL, 0x8100604208113000ULL,
+    0x0409200020880100ULL, 0x20C6008903040023ULL, 0x0121501002882002ULL,
+    0x0010500121240800ULL, 0x0020AA4C00408058ULL, 0x0022240048041000ULL,
+    0x2000010861042000ULL, 0x0002800100411000ULL, 0x4090000804208825ULL,
+    0x0080000812320208ULL, 0xC00008C011620220ULL, 0x00B4100282780210ULL,
+    0x0820021000608480ULL
+  };
+
+// the sets of positions a sliding piece can reach in one move (if the
+// positions are empty or hold an opponent piece), found by looking up
+// the occupied positions in tables.  for each starting position, a
+// mask selects the positions that could block a rook's moves (or a
+// bishop's moves), which are the positions it could reach on an empty
+// board, less the last one in each direction.  the occupied positions
+// in the mask are converted to an index into a table of the reachable
+// sets.  when compiled for a processor with the BMI2 instructions,
+// the PEXT instruction gathers the masked bits to form the index.
+// otherwise, the masked bits are multiplied by a "magic" number that
+// leaves an index in the top bits of the product, which is the same
+// for two patterns of blocking pieces only if they block the same
+// moves.
+LOCAL class SLIDEATTACKS
+  {
+  public:
+    // look-up for one kind of move from one starting position
+    class LOOKUP
       {
-        col += delta;
-        if (col == limit)
-          return;
-        if (board.whatPiece(row, col))
-          if (board.whatPiece(row, col)->whatColor() == color)
-            return;
-        moves.end[moves.nMoves].row = row;
-        moves.end[moves.nMoves++].col = col;
-        if (board.whatPiece(row, col))
-          return;
+      public:
+        BITBOARD mask;
+        BITBOARD magic;
+        int shift;
+        // table of reachable sets
+        BITBOARD *attacks;
+
+        // index into attacks for the given occupied positions
+        int index(BITBOARD occupied) const
+          {
+            #if defined(__BMI2__)
+            return((int) _pext_u64(occupied, mask));
+            #else
+            return((int) (((occupied & mask) * magic) >> shift));
+            #endif
+          }
+
+        BITBOARD reachable(BITBOARD occupied) const
+          { return(attacks[index(occupied)]); }
+      };
+
+    LOOKUP rook[NUMPOSITIONS], bishop[NUMPOSITIONS];
+
+    // for each starting position and direction, the positions that can
+    // be reached in the direction on an empty board
+    BITBOARD ray[NUMPOSITIONS][nSlideDirections];
+
+    SLIDEATTACKS(void)
+      {
+        int i, d;
+
+        for (i = 0; i < NUMPOSITIONS; i++)
+          for (d = 0; d < nSlideDirections; d++)
+            ray[i][d] = walk(IndexPosition(i), d, 0, FALSE);
+
+        build(rook, 0, rookMagic, rookTable);
+        build(bishop, FIRSTBISHOPDIRECTION, bishopMagic, bishopTable);
+      }
+
+  private:
+    // a table entry for each pattern of blocking pieces, for each
+    // starting position.  sizes are the sums over all positions of 2
+    // to the number of positions in the mask.
+    BITBOARD rookTable[0x19000];
+    BITBOARD bishopTable[0x1480];
+
+    // positions reached by sliding from start in direction d, stopping
+    // at the first occupied position.  if edgeless, the last position
+    // in the direction is left out.
+    CLASSMEMBER BITBOARD walk
+      (
+        POSITION start,
+        int d,
+        BITBOARD occupied,
+        BOOL edgeless
+      )
+      {
+        BITBOARD set = 0, bit;
+
+        for ( ; ; )
+          {
+            start.row += slideDirection[d].row;
+            start.col += slideDirection[d].col;
+            if ((start.row < 0) || (start.row >= NUMROWS) ||
+                (start.col < 0) || (start.col >= NUMCOLS))
+              break;
+            if (edgeless &&
+                ((start.row + slideDirection[d].row) < 0 ||
+                 (start.row + slideDirection[d].row) >= NUMROWS ||
+                 (start.col + slideDirection[d].col) < 0 ||
+                 (start.col + slideDirection[d].col) >= NUMCOLS))
+              break;
+            bit = PositionBit(start);
+            set |= bit;
+            if (occupied & bit)
+              break;
+          }
+
+        return(set);
+      }
+
+    // positions reached in the four directions starting with firstDir
+    CLASSMEMBER BITBOARD reach
+      (
+        POSITION start,
+        int firstDir,
+        BITBOARD occupied,
+        BOOL edgeless
+      )
+      {
+        BITBOARD set = 0;
+        int d;
+
+        for (d = firstDir; d < (firstDir + 4); d++)
+          set |= walk(start, d, occupied, edgeless);
+
+        return(set);
+      }
+
+    // fill in the look-ups for all starting positions for the moves in
+    // the four directions starting with firstDir, using table for the
+    // reachable sets
+    void build
+      (
+        LOOKUP *lookUp,
+        int firstDir,
+        const BITBOARD *magic,
+        BITBOARD *table
+      )
+      {
+        int i, nBits;
+        BITBOARD sub;
+
+        for (i = 0; i < NUMPOSITIONS; i++)
+          {
+            LOOKUP &l = lookUp[i];
+
+            l.mask = reach(IndexPosition(i), firstDir, 0, TRUE);
+            l.magic = magic[i];
+            nBits = CountPositions(l.mask);
+            l.shift = NUMPOSITIONS - nBits;
+            l.attacks = table;
+            table += 1 << nBits;
+
+            // visit each subset of the mask
+            sub = 0;
+            do
+              {
+                l.attacks[l.index(sub)] =
+                  reach(IndexPosition(i), firstDir, sub, FALSE);
+                sub = (sub - l.mask) & l.mask;
+              }
+            while (sub);
+          }
+
+        return;
       }
   }
+SlideAttacks;
 
-// list all legal vertical moves in one direction from a given starting
-// point
-LOCAL void vertMoves
+// add the positions in a set to the list of moves, in order of
+// increasing (or decreasing, if descending is TRUE) bit index
+LOCAL inline void addPositions
   (
-    int row,
-    int col,
-    int delta,
-    const BOARD &board,
+    BITBOARD set,
+    BOOL descending,
     POSITIONLIST &moves
   )
   {
-    int limit = delta == 1 ? NUMROWS : -1;
-    PIECECOLOR color = board.whatPiece(row, col)->whatColor();
+    int i;
 
-    for ( ; ; )
+    while (set)
       {
-        row += delta;
-        if (row == limit)
-          return;
-        if (board.whatPiece(row, col))
-          if (board.whatPiece(row, col)->whatColor() == color)
-            return;
-        moves.end[moves.nMoves].row = row;
-        moves.end[moves.nMoves++].col = col;
-        if (board.whatPiece(row, col))
-          return;
+        if (descending)
+          {
+            i = (NUMPOSITIONS - 1) - __builtin_clzll(set);
+            set ^= ((BITBOARD) 1) << i;
+          }
+        else
+          {
+            i = __builtin_ctzll(set);
+            set = RemoveFirst(set);
+          }
+        moves.end[moves.nMoves++] = IndexPosition(i);
       }
+
+    return;
   }
 
-// list all legal rook moves from a given starting point
-LOCAL void rookMoves
+// list the moves of a sliding piece in the four directions starting
+// with firstDir, given the set of positions it can reach.  the moves
+// in each direction are listed going away from the start.
+LOCAL inline void slideMoves
   (
-    int row,
-    int col,
-    const BOARD &board,
+    int start,
+    int firstDir,
+    BITBOARD reachable,
     POSITIONLIST &moves
   )
   {
-    horzMoves(row, col, 1, board, moves);
-    horzMoves(row, col, -1, board, moves);
-    vertMoves(row, col, 1, board, moves);
-    vertMoves(row, col, -1, board, moves);
+    int d;
+
+    for (d = firstDir; d < (firstDir + 4); d++)
+      addPositions(reachable & SlideAttacks.ray[start][d],
+                   (slideDirection[d].row * NUMCOLS +
+                    slideDirection[d].col) < 0,
+                   moves);
 
     return;
   }
 
-// list all legal diagonal moves from a given starting point in a
-// single direction
-LOCAL void diagMoves
+// list all legal rook moves from a given starting point
+LOCAL void rookMoves
   (
     int row,
     int col,
-    int rowDelta,
-    int colDelta,
     const BOARD &board,
     POSITIONLIST &moves
   )
   {
-    int rowLimit = rowDelta == 1 ? NUMROWS : -1;
-    int colLimit = colDelta == 1 ? NUMCOLS : -1;
-    PIECECOLOR color = board.whatPiece(row, col)->whatColor();
+    int start = PositionIndex(POSITION(row, col));
+    BITBOARD own = board.whatPieces(board.whatPiece(row, col)->whatColor());
 
-    for ( ; ; )
-      {
-        row += rowDelta;
-        col += colDelta;
-        if ((row == rowLimit) || (col == colLimit))
-          return;
-        if (board.whatPiece(row, col))
-          if (board.whatPiece(row, col)->whatColor() == color)
-            return;
-        moves.end[moves.nMoves].row = row;
-        moves.end[moves.nMoves++].col = col;
-        if (board.whatPiece(row, col))
-          return;
-      }
+    slideMoves(start, 0,
+               SlideAttacks.rook[start].reachable(board.occupied()) & ~own,
+               moves);
+
+    return;
   }
 
 // list all legal bishop moves from a given starting point
@@ -1000,10 +2535,12 @@ LOCAL void bishopMoves
     POSITIONLIST &moves
   )
   {
-    diagMoves(row, col, 1, 1, board, moves);
-    diagMoves(row, col, 1, -1, board, moves);
-    diagMoves(row, col, -1, 1, board, moves);
-    diagMoves(row, col, -1, -1, board, moves);
+    int start = PositionIndex(POSITION(row, col));
+    BITBOARD own = board.whatPieces(board.whatPiece(row, col)->whatColor());
+
+    slideMoves(start, FIRSTBISHOPDIRECTION,
+               SlideAttacks.bishop[start].reachable(board.occupied()) & ~own,
+               moves);
 
     return;
   }
@@ -1075,36 +2612,253 @@ const POSITIONOFFSET knightOffset[] =
     { -1, -2 }, { -2, -1 } };
 const int nKnightOffsets = ARRAY_LENGTH(knightOffset);
 
+// for each position, the sets of positions that a king, a knight, or a
+// pawn of each color could capture from it
+LOCAL class LEAPATTACKS
+  {
+  public:
+    BITBOARD king[NUMPOSITIONS];
+    BITBOARD knight[NUMPOSITIONS];
+    // indexed by color of pawn
+    BITBOARD pawn[2][NUMPOSITIONS];
+
+    LEAPATTACKS(void)
+      {
+        const POSITIONOFFSET pawnOffset[2][2] =
+          { { { -1, 1 }, { 1, 1 } }, { { -1, -1 }, { 1, -1 } } };
+        int i, c;
+
+        for (i = 0; i < NUMPOSITIONS; i++)
+          {
+            king[i] = fromOffsets(i, nKingOffsets, kingOffset);
+            knight[i] = fromOffsets(i, nKnightOffsets, knightOffset);
+            for (c = 0; c < 2; c++)
+              pawn[c][i] = fromOffsets(i, 2, pawnOffset[c]);
+          }
+      }
+
+  private:
+    CLASSMEMBER BITBOARD fromOffsets
+      (
+        int start,
+        int nOffsets,
+        const POSITIONOFFSET *offset
+      )
+      {
+        POSITION where = IndexPosition(start);
+        BITBOARD set = 0;
+        int i;
+
+        for (i = 0; i < nOffsets; i++)
+          if (withinBoard(where.row + offset[i].row,
+                          where.col + offset[i].col))
+            set |= PositionBit(POSITION(where.row + offset[i].row,
+                                        where.col + offset[i].col));
+
+        return(set);
+      }
+  }
+LeapAttacks;
+
+BITBOARD BOARD::attackers
+  (
+    POSITION where,
+    PIECECOLOR byColor,
+    BITBOARD occupiedNow
+  ) const
+  {
+    int i = PositionIndex(where);
+    const BITBOARD *pieces = pieceBits[byColor];
+
+    // look from the position outwards, as each kind of piece would
+    // move, for a piece of that kind.  a pawn of byColor can capture
+    // in the position from wherever a pawn of the other color could
+    // capture.
+    return((LeapAttacks.king[i] & pieces[TYPEKING]) |
+           (LeapAttacks.knight[i] & pieces[TYPEKNIGHT]) |
+           (LeapAttacks.pawn[OtherColor(byColor)][i] & pieces[TYPEPAWN]) |
+           (SlideAttacks.rook[i].reachable(occupiedNow) &
+            (pieces[TYPEROOK] | pieces[TYPEQUEEN])) |
+           (SlideAttacks.bishop[i].reachable(occupiedNow) &
+            (pieces[TYPEBISHOP] | pieces[TYPEQUEEN])));
+  }
+
+BITBOARD BOARD::pieceAttacks(int i) const
+  {
+    BITBOARD bit = ((BITBOARD) 1) << i, occupiedNow = occupied();
+    int c;
+
+    for (c = 0; c < 2; c++)
+      {
+        if (!(colorBits[c] & bit))
+          continue;
+
+        if (pieceBits[c][TYPEPAWN] & bit)
+          return(LeapAttacks.pawn[c][i]);
+        if (pieceBits[c][TYPEKNIGHT] & bit)
+          return(LeapAttacks.knight[i]);
+        if (pieceBits[c][TYPEKING] & bit)
+          return(LeapAttacks.king[i]);
+        if (pieceBits[c][TYPEROOK] & bit)
+          return(SlideAttacks.rook[i].reachable(occupiedNow));
+        if (pieceBits[c][TYPEBISHOP] & bit)
+          return(SlideAttacks.bishop[i].reachable(occupiedNow));
+        // a queen moves as both a rook and a bishop
+        return(SlideAttacks.rook[i].reachable(occupiedNow) |
+               SlideAttacks.bishop[i].reachable(occupiedNow));
+      }
+
+    return(0);
+  }
+
+void BOARD::computeAttacks(void)
+  {
+    int i;
+
+    for (i = 0; i < NUMPOSITIONS; i++)
+      attackBits[i] = pieceAttacks(i);
+
+    return;
+  }
+
+void BOARD::updateAttacks(POSITION where)
+  {
+    int i = PositionIndex(where);
+    BITBOARD occupiedNow = occupied();
+    BITBOARD rooks = pieceBits[WHITE][TYPEROOK] | pieceBits[BLACK][TYPEROOK];
+    BITBOARD bishops =
+      pieceBits[WHITE][TYPEBISHOP] | pieceBits[BLACK][TYPEBISHOP];
+    BITBOARD queens =
+      pieceBits[WHITE][TYPEQUEEN] | pieceBits[BLACK][TYPEQUEEN];
+    BITBOARD sliders;
+
+    // while a capture is being done or undone, both pieces are briefly
+    // in the position, and the set is fixed up when one is removed
+    attackBits[i] = pieceAttacks(i);
+
+    // a piece that could move to the position is the one whose moves
+    // past it have changed
+    sliders =
+      (SlideAttacks.rook[i].reachable(occupiedNow) & (rooks | queens)) |
+      (SlideAttacks.bishop[i].reachable(occupiedNow) & (bishops | queens));
+    for ( ; sliders; sliders = RemoveFirst(sliders))
+      attackBits[__builtin_ctzll(sliders)] =
+        pieceAttacks(__builtin_ctzll(sliders));
+
+    return;
+  }
+
+void BOARD::trackAttacks(BOOL track)
+  {
+    attacksTracked = track;
+    if (attacksTracked)
+      computeAttacks();
+
+    return;
+  }
+
+void BOARD::findPins
+  (
+    PIECECOLOR color,
+    BITBOARD &evasions,
+    BITBOARD &pinned,
+    BITBOARD *pinRay
+  ) const
+  {
+    int k = PositionIndex(whereKing(color));
+    const BITBOARD *enemy = pieceBits[OtherColor(color)];
+    BITBOARD checkers, block = 0, sliders, between, blockers;
+    int d, s;
+
+    checkers = (LeapAttacks.knight[k] & enemy[TYPEKNIGHT]) |
+               (LeapAttacks.pawn[color][k] & enemy[TYPEPAWN]);
+    pinned = 0;
+
+    // look outwards from the king in each direction for the nearest
+    // opponent piece that could move back along the direction.  if
+    // nothing is between, it is checking the king.  if only a piece of
+    // the king's color is between, that piece is pinned.
+    for (d = 0; d < nSlideDirections; d++)
+      {
+        sliders = enemy[TYPEQUEEN] |
+                  (d < FIRSTBISHOPDIRECTION ? enemy[TYPEROOK] :
+                                              enemy[TYPEBISHOP]);
+        sliders &= SlideAttacks.ray[k][d];
+        if (!sliders)
+          continue;
+
+        if ((slideDirection[d].row * NUMCOLS + slideDirection[d].col) < 0)
+          s = (NUMPOSITIONS - 1) - __builtin_clzll(sliders);
+        else
+          s = __builtin_ctzll(sliders);
+        between = SlideAttacks.ray[k][d] & ~SlideAttacks.ray[s][d] &
+                  ~(((BITBOARD) 1) << s);
+        blockers = between & occupied();
+
+        if (!blockers)
+          {
+            checkers |= ((BITBOARD) 1) << s;
+            block |= between;
+          }
+        else if (!RemoveFirst(blockers) && (blockers & colorBits[color]))
+          {
+            pinned |= blockers;
+            pinRay[__builtin_ctzll(blockers)] =
+              between | (((BITBOARD) 1) << s);
+          }
+      }
+
+    if (!checkers)
+      evasions = ~((BITBOARD) 0);
+    else if (RemoveFirst(checkers))
+      // only the king can get out of a double check
+      evasions = 0;
+    else
+      evasions = checkers | block;
+
+    return;
+  }
+
+SITUATIONOFKING BOARD::kingSituation(PIECECOLOR color) const
+  {
+    MOVELIST moves;
+
+    listMoves(color, moves, FALSE);
+
+    // a castle is never the only legal move, since the rook could
+    // move instead
+    if (moves.nMoves)
+      return(KINGOK);
+
+    return(inCheck(color) ? KINGLOST : STALEMATE);
+  }
+
 void PAWN::promote(PIECETYPE promoteType)
   {
     switch (promoteType)
       {
       case TYPEQUEEN:
-        promotePiece = new QUEEN(whatColor());
+        promotePiece = &promotedQueen[whatColor()];
         break;
 
       case TYPEROOK:
-        promotePiece = new ROOK(whatColor());
+        promotePiece = &promotedRook[whatColor()];
         break;
 
       case TYPEBISHOP:
-        promotePiece = new BISHOP(whatColor());
+        promotePiece = &promotedBishop[whatColor()];
         break;
 
       case TYPEKNIGHT:
-        promotePiece = new KNIGHT(whatColor());
+        promotePiece = &promotedKnight[whatColor()];
         break;
       }
 
-    if (!promotePiece)
-      OutOfMemory();
-
     return;
   }
 
 void PAWN::restoreToPawn(void)
   {
-    delete promotePiece;
     promotePiece = (PIECE *) 0;
 
     return;
@@ -1264,3 +3018,118 @@ void KING::legalMoves
 
     return;
   }
+
+void MoveText
+  (
+    PIECECOLOR color,
+    const PIECEMOVE &move,
+    char *text
+  )
+  {
+    // POSITION.row is the file and POSITION.col is the rank
+    POSITION start = move.start, end = move.end;
+
+    if (move.type != NORMALMOVE)
+      {
+        start = POSITION(4, color == WHITE ? 0 : (NUMCOLS - 1));
+        end = POSITION(move.type == KINGSIDECASTLE ? 6 : 2, start.col);
+      }
+
+    text[0] = (char) ('a' + start.row);
+    text[1] = (char) ('1' + start.col);
+    text[2] = (char) ('a' + end.row);
+    text[3] = (char) ('1' + end.col);
+    text[4] = '\0';
+
+    if (move.type == NORMALMOVE)
+      switch (move.promoteType)
+        {
+        case TYPEQUEEN:
+          text[4] = 'q';
+          break;
+
+        case TYPEROOK:
+          text[4] = 'r';
+          break;
+
+        case TYPEBISHOP:
+          text[4] = 'b';
+          break;
+
+        case TYPEKNIGHT:
+          text[4] = 'n';
+          break;
+
+        default:
+          break;
+        }
+    text[5] = '\0';
+
+    return;
+  }
+
+BOOL FindTextMove
+  (
+    const BOARD &board,
+    PIECECOLOR color,
+    const char *text,
+    PIECEMOVE &move
+  )
+  {
+    MOVELIST moves;
+    char moveText[6];
+    int m, nMoves;
+
+    // a pawn may be promoted to any piece, not only the ones the
+    // look-ahead tries
+    board.listMoves(color, moves, FALSE);
+    nMoves = moves.nMoves;
+    for (m = 0; m < nMoves; m++)
+      if ((moves.move[m].type == NORMALMOVE) &&
+          (moves.move[m].promoteType == TYPEQUEEN))
+        {
+          moves.move[moves.nMoves] = moves.move[m];
+          moves.move[moves.nMoves++].promoteType = TYPEROOK;
+          moves.move[moves.nMoves] = moves.move[m];
+          moves.move[moves.nMoves++].promoteType = TYPEBISHOP;
+        }
+    if (board.userCanCastle(QUEENSIDECASTLE, color))
+      moves.move[moves.nMoves++] = PIECEMOVE(QUEENSIDECASTLE);
+    if (board.userCanCastle(KINGSIDECASTLE, color))
+      moves.move[moves.nMoves++] = PIECEMOVE(KINGSIDECASTLE);
+
+    for (m = 0; m < moves.nMoves; m++)
+      {
+        MoveText(color, moves.move[m], moveText);
+        if (strcmp(moveText, text) == 0)
+          {
+            move = moves.move[m];
+            return(TRUE);
+          }
+      }
+
+    return(FALSE);
+  }
+
+void DoPieceMove
+  (
+    BOARD &board,
+    PIECECOLOR color,
+    const PIECEMOVE &move
+  )
+  {
+    MOVEUNDODATA undoData;
+
+    if (move.type != NORMALMOVE)
+      board.castle(move.type, color, undoData);
+    else
+      {
+        board.doMove(move.start, move.end, undoData);
+        if (move.promoteType != TYPENOPIECE)
+          board.promote(move.end, move.promoteType);
+        if (undoData.capturedPiece)
+          delete undoData.capturedPiece;
+      }
+
+    return;
+  }
@@ -92,8 +92,44 @@ class PIECEMOVE
       ) : type(t) { }
   };
 
+// writes a move by the given color in coordinate notation, as the
+// starting and ending squares (with the king's squares for a castle),
+// followed by the piece promoted to, for example "e2e4", "e1g1" or
+// "a7a8q".  text must have room for 6 characters.
+void MoveText(PIECECOLOR color, const PIECEMOVE &move, char *text);
+
 class PIECE;
 
+// key identifying a board position (for zobrist hashing)
+typedef unsigned long long HASHKEY;
+
+// a set of board positions, with one bit for each position.  the
+// positions are numbered row by row, so the first position in a set
+// is the first one a row by row scan of the board would find.
+typedef unsigned long long BITBOARD;
+
+inline int PositionIndex(POSITION p)
+  { return((p.row * NUMCOLS) + p.col); }
+
+inline POSITION IndexPosition(int i)
+  { return(POSITION(i / NUMCOLS, i % NUMCOLS)); }
+
+// set containing only the given position
+inline BITBOARD PositionBit(POSITION p)
+  { return(((BITBOARD) 1) << PositionIndex(p)); }
+
+// number of positions in a set
+inline int CountPositions(BITBOARD b)
+  { return(__builtin_popcountll(b)); }
+
+// first position in a set, which must not be empty
+inline POSITION FirstPosition(BITBOARD b)
+  { return(IndexPosition(__builtin_ctzll(b))); }
+
+// set without its first position
+inline BITBOARD RemoveFirst(BITBOARD b)
+  { return(b & (b - 1)); }
+
 // records whether the current move is an en passant capture, or
 // follows a two-rank move of a pawn
 enum EFFECTENPASSANT { ENPASSANTCAPTURE, AFTERDOUBLEMOVE, OTHERMOVE };
@@ -109,6 +145,8 @@ class MOVEUNDODATA
     // if enPassantEffect not OTHERMOVE, records position of
     // previously double-moved pawn
     POSITION saveDoubleMoved;
+    // hash key of the board before the move
+    HASHKEY saveHashKey;
   };
 
 // evalution of change in relative situation of the two players after
@@ -140,6 +178,68 @@ class BESTMOVES
     PIECEMOVE move[MAXPIECES * MAXMOVES];
   };
 
+// list of all the (non-castling) moves for one color, in the order
+// they should be tried
+class MOVELIST
+  {
+  public:
+    // number of moves in list
+    int nMoves;
+    PIECEMOVE move[MAXPIECES * MAXMOVES];
+    // how promising each move is, higher scores are tried first
+    int score[MAXPIECES * MAXMOVES];
+  };
+
+// most moves of look-ahead for which the positions reached are
+// counted separately
+const int MAXSTATSLOOKAHEAD = 32;
+
+// statistics of one look-ahead (one call to findBestMoves)
+class SEARCHSTATS
+  {
+  public:
+    // number of moves looked ahead
+    int lookAhead;
+    // number of positions reached by a move, by the number of moves
+    // before it in the look-ahead (0 for the first move)
+    unsigned long long nodes[MAXSTATSLOOKAHEAD];
+    // positions reached by the last move of the look-ahead (included
+    // in nodes)
+    unsigned long long leaves;
+    // positions reached by the captures and promotions tried after the
+    // last move (not included in nodes)
+    unsigned long long quiesceNodes;
+    // numbers of promotions and castles tried
+    unsigned long long promotions;
+    unsigned long long castles;
+    // positions whose result was found in the transposition table
+    unsigned long long tableHits;
+    // time taken
+    CLOCKTIME time;
+    // TRUE if the look-ahead was abandoned because of the deadline
+    BOOL abandoned;
+
+    // set all the counts to 0
+    void clear(void);
+
+    // add in the counts of a look-ahead done in parallel
+    void add(const SEARCHSTATS &s);
+
+    // total positions reached by a move
+    unsigned long long total(void) const;
+
+    // effective branching factor, the number of moves from each
+    // position that would give the total number of positions if every
+    // position had the same number of moves
+    double branchingFactor(void) const;
+  };
+
+// longest position written by BOARD::writeFen, including the
+// terminating null
+const int MAXFENLENGTH = 96;
+
+class ROOTSPLIT;
+
 // internal representation of chess board
 class BOARD
   {
@@ -152,6 +252,82 @@ class BOARD
     // if last move was double pawn move, contains the ending position
     // of the pawn.
     POSITION doubleMovedPawn;
+    // zobrist hash key of the pieces on the board, the en passant
+    // state and the castling rights, updated with each change to the
+    // board.  does not include the color of the player to move.
+    HASHKEY hashKey;
+    // sets of the positions of the pieces of each color and type, and
+    // of all the pieces of each color, kept in step with brd.  a
+    // promoted pawn is in the set for the type it was promoted to.
+    BITBOARD pieceBits[2][TYPENOPIECE];
+    BITBOARD colorBits[2];
+    // if attacksTracked is TRUE, the set of positions the piece in
+    // each position could capture in (empty for an empty position),
+    // kept in step with the position sets.  see trackAttacks.
+    BITBOARD attackBits[NUMROWS * NUMCOLS];
+    BOOL attacksTracked;
+
+    // if not 0, the time at which searches are abandoned
+    CLOCKTIME deadline;
+    // set to TRUE when a search is abandoned because the deadline
+    // passed
+    BOOL searchAbandoned;
+    // number of positions to examine before next checking the clock
+    int untilClockCheck;
+    // statistics of the last look-ahead
+    SEARCHSTATS stats;
+
+    // computes the hash key for the board from scratch
+    HASHKEY computeHashKey(void) const;
+
+    // computes the sets of piece positions from scratch
+    void computeBits(void);
+
+    // adds the given piece at the given position to the hash key and
+    // position sets if it is not in them, or removes it if it is
+    void flipPiece(const PIECE *p, POSITION where);
+
+    // finds the set of positions the piece in the position with the
+    // given index could capture in, from the position sets
+    BITBOARD pieceAttacks(int i) const;
+
+    // computes attackBits from scratch
+    void computeAttacks(void);
+
+    // updates attackBits after a piece is added to or removed from
+    // the given position, for the position and for the rooks, bishops
+    // and queens whose moves pass through it
+    void updateAttacks(POSITION where);
+
+    // finds the positions a piece of the given color other than the
+    // king could move to to get the king out of check (all positions
+    // if it is not in check), and the set of pieces of the color that
+    // can't leave the line between the king and an opponent piece.
+    // for each such pinned piece, the positions on the line it can
+    // move to are put in pinRay, indexed by the piece's position.
+    void findPins
+      (
+        PIECECOLOR color,
+        BITBOARD &evasions,
+        BITBOARD &pinned,
+        BITBOARD *pinRay
+      ) const;
+
+    // returns a bit mask of the castling moves still allowed by the
+    // king and rook move history, with a bit for each color and side
+    int castleRights(void) const;
+
+    // part of the hash key for the en passant state
+    HASHKEY enPassantKey(void) const;
+
+    // moves a piece, as described for doMove, without updating the
+    // hash key
+    void movePiece
+      (
+        POSITION start,
+        POSITION end,
+        MOVEUNDODATA &undoData
+      );
 
     // recursive function to find optimal moves in terms of
     // getting opponent in checkmate or material gain.
@@ -164,11 +340,91 @@ class BOARD
         // metric of optimal moves
         BOARDMETRIC &metric,
         // if not null, filled in with list of optimal moves
-        BESTMOVES *bestMoves
+        BESTMOVES *bestMoves,
+        // if not null, the best metric (for the opponent) found so far
+        // for the opponent's move into this position.  once a move is
+        // found that is better than that for the player to move, the
+        // opponent would not make its move, so the rest of the moves
+        // need not be examined.
+        const BOARDMETRIC *opponentBest,
+        // if TRUE, a move with a metric that might equal opponentBest
+        // is not enough to stop, because the opponent is looking for
+        // all of its moves with the optimal metric
+        BOOL opponentKeepsTies,
+        // if TRUE, after the last move of look-ahead, the look-ahead is
+        // continued with captures and promotions only (see quiesce)
+        BOOL quiesceLeaves
+      );
+
+    // continues a look-ahead past its last move, trying only captures
+    // and promotions, until neither player can gain any more material.
+    // the player to move may also choose to make none of these moves
+    // ("stand pat"), and keep the position as it is.  metrics are
+    // converted to scores (see quiesceScore in chess.cpp), so that
+    // each player's gain is the other's loss.  returns the score for
+    // the player to move, or a score no better than alpha if the
+    // player can't do better than alpha, or a score at least as good
+    // as beta if the player can do at least as well as beta.
+    int quiesce
+      (
+        PIECECOLOR moveColor,
+        // score of the position as it is
+        int standPat,
+        int alpha,
+        int beta
+      );
+
+    // find the metric for the position after the last move of
+    // look-ahead, using quiesce.  the parameters are as for
+    // helpFindBestMoves.
+    void quiesceMetric
+      (
+        PIECECOLOR moveColor,
+        BOARDMETRIC &metric,
+        const BOARDMETRIC *opponentBest,
+        BOOL opponentKeepsTies
       );
 
+    // do the given move, find its metric by looking ahead from the
+    // resulting position, and undo the move.  the move must be legal.
+    void lookAheadMove
+      (
+        const PIECEMOVE &move,
+        // number of moves to look-ahead, including the given move
+        int lookAhead,
+        PIECECOLOR moveColor,
+        // passed in with the material change before the move, set to
+        // the metric of the move
+        BOARDMETRIC &testMetric,
+        // if not null, the best metric found so far for other moves
+        // from the same position.  the look-ahead from the move may stop
+        // once it is known the move's metric won't be as good.
+        const BOARDMETRIC *best,
+        // if TRUE, a metric that would equal best must be found exactly
+        BOOL keepTies,
+        BOOL quiesceLeaves
+      );
+
+    // search the first moves of a look-ahead in parallel with other
+    // threads, each with its own copy of the board
+    void searchSplit(ROOTSPLIT &split);
+
+    // run by each thread of SearchThreads to search the first moves
+    // of a look-ahead.  arg points to the ROOTSPLIT.
+    CLASSMEMBER void splitJob(void *arg, int thread);
+
+    // checks if the deadline for a search has passed, or searches have
+    // been stopped, returning TRUE if the search is abandoned
+    BOOL pastDeadline(void);
+
+    // boards are only copied by the copy constructor
+    BOARD & operator = (const BOARD &);
+
   public:
     BOARD(void);
+    // makes a copy of each piece, so the copy can be changed
+    // independently
+    BOARD(const BOARD &board);
     ~BOARD(void);
 
     PIECE *whatPiece(POSITION p) const
@@ -177,6 +433,85 @@ class BOARD
     PIECE *whatPiece(int row, int col) const
       { return(brd[row][col]); }
 
+    // set of the positions of the pieces of the given color and type
+    BITBOARD whatPieces(PIECECOLOR color, PIECETYPE type) const
+      { return(pieceBits[color][type]); }
+
+    // set of the positions of all the pieces of the given color
+    BITBOARD whatPieces(PIECECOLOR color) const
+      { return(colorBits[color]); }
+
+    // set of the positions with a piece in them
+    BITBOARD occupied(void) const
+      { return(colorBits[WHITE] | colorBits[BLACK]); }
+
+    // position of the king of the given color, which must be on the
+    // board
+    POSITION whereKing(PIECECOLOR color) const
+      { return(FirstPosition(pieceBits[color][TYPEKING])); }
+
+    // returns the set of the positions of the pieces of the given
+    // color that could capture a piece of the other color in the given
+    // position, if the pieces in the board were in the positions in
+    // occupiedNow (which must include all of byColor's pieces)
+    BITBOARD attackers
+      (
+        POSITION where,
+        PIECECOLOR byColor,
+        BITBOARD occupiedNow
+      ) const;
+
+    // the same, with the pieces where they are
+    BITBOARD attackers(POSITION where, PIECECOLOR byColor) const
+      { return(attackers(where, byColor, occupied())); }
+
+    // starts (if track is TRUE) or stops keeping the sets of
+    // positions each piece could capture in up to date as moves are
+    // done and undone.  this makes each move slower, so it is not done
+    // while looking ahead, only while moves are compared by the sets.
+    void trackAttacks(BOOL track);
+
+    // set of the positions the piece in the given position could
+    // capture in.  attacks must be tracked.
+    BITBOARD attacksFrom(POSITION where) const
+      { return(attackBits[PositionIndex(where)]); }
+
+    // set of the positions any of the pieces in the given positions
+    // could capture in.  attacks must be tracked.
+    BITBOARD attacksFrom(BITBOARD pieces) const
+      {
+        BITBOARD set = 0;
+
+        for ( ; pieces; pieces = RemoveFirst(pieces))
+          set |= attackBits[__builtin_ctzll(pieces)];
+
+        return(set);
+      }
+
+    // returns TRUE if the king of the given color could be taken by
+    // the other color's next move
+    BOOL inCheck(PIECECOLOR color) const
+      { return(attackers(whereKing(color), OtherColor(color)) != 0); }
+
+    // fill in the list of all the legal moves for the given color,
+    // other than castling moves (see userCanCastle).  the moves the
+    // pieces of the color would make are found by visiting only those
+    // pieces, using the sets of positions, and moves that would leave
+    // the king in check are left out.  moves that are likely to be best
+    // are put first, so that the rest are more likely to be refuted
+    // quickly when looking ahead:  promotions, then captures, most
+    // valuable victim first, and by the least valuable attacker for
+    // the same victim.  moves that are not
+    // captures are left in the order in which they were found.  a pawn
+    // reaching the last rank is only promoted to a queen or a knight.
+    void listMoves
+      (
+        PIECECOLOR moveColor,
+        MOVELIST &list,
+        // if TRUE, only captures and promotions are listed
+        BOOL capturesOnly
+      ) const;
+
     // perform a move.  move is not validated (assumed to be legal).
     void doMove
       (
@@ -203,7 +538,7 @@ class BOARD
     // given side (as given by whichCastle).  the one preventing
     // condition not cheched for is if the final position of the king
     // places it in check.
-    BOOL canCastle(MOVETYPE whichCastle, PIECECOLOR color);
+    BOOL canCastle(MOVETYPE whichCastle, PIECECOLOR color) const;
 
     // do a castle on the given side with the king of given color.
     // no validation, assumed to be legal.
@@ -231,8 +566,28 @@ class BOARD
         POSITION end
       );
 
+    // sets up the board from a position in Forsyth-Edwards Notation
+    // (FEN), or from the first four fields of an EPD record, and
+    // returns the color to move.  the castling field is kept by
+    // marking kings and rooks that can't castle as having been moved.
+    // the move counters of FEN and the operations of EPD are ignored.
+    // returns FALSE, leaving the board as it was, if the text is not a
+    // valid position.
+    BOOL readFen(const char *fen, PIECECOLOR &moveColor);
+
+    // writes the position, with the given color to move, in FEN, or
+    // as the four fields of an EPD record if epd is TRUE.  since the
+    // board does not keep move counters, FEN is written with 0 moves
+    // since the last capture or pawn move, at move 1.  text must have
+    // room for MAXFENLENGTH characters.
+    void writeFen(PIECECOLOR moveColor, char *text, BOOL epd = FALSE) const;
+
     // complete check of whether a castle move can be done
-    BOOL userCanCastle(MOVETYPE whichCastle, PIECECOLOR color);
+    BOOL userCanCastle(MOVETYPE whichCastle, PIECECOLOR color) const;
+
+    // returns KINGLOST if the given color is check mated, STALEMATE if
+    // it is stale mated, and KINGOK if it has a legal move
+    SITUATIONOFKING kingSituation(PIECECOLOR color) const;
 
     // returns TRUE if the last move was a double pawn move.  if
     // TRUE, the ending position of the pawn is returned as well.
@@ -243,25 +598,63 @@ class BOARD
         return(wasLastMoveDoublePawn);
       }
 
-    // front end for helpFindBestMoves.  simply initializes the
-    // material change to 0.
+    // returns the hash key for the board with the player of the given
+    // color to move
+    HASHKEY whatHashKey(PIECECOLOR moveColor) const;
+
+    // set the time (as returned by ClockNow) at which searches are
+    // abandoned, 0 for no limit.  clears the indication that a search
+    // was abandoned.
+    void setDeadline(CLOCKTIME d)
+      {
+        deadline = d;
+        searchAbandoned = FALSE;
+        untilClockCheck = 0;
+      }
+
+    // returns TRUE if a search was abandoned since the last call to
+    // setDeadline (because of the deadline, or because searches were
+    // stopped by StopSearches).  the results of the search are not
+    // valid.
+    BOOL searchWasAbandoned(void) const { return(searchAbandoned); }
+
+    // returns the statistics of the last call to findBestMoves,
+    // including the positions examined by the other threads
+    const SEARCHSTATS &searchStats(void) const { return(stats); }
+
+    // front end for helpFindBestMoves.  initializes the material
+    // change to 0, and collects the statistics of the look-ahead.
     void findBestMoves
       (
         int lookAhead,
         PIECECOLOR moveColor,
         BOARDMETRIC &metric,
-        BESTMOVES *bestMoves
-      )
-      {
-        metric.materialDiff = 0;
-
-        helpFindBestMoves(lookAhead, moveColor, metric, bestMoves);
-
-        return;
-      }
+        BESTMOVES *bestMoves,
+        BOOL quiesceLeaves = FALSE
+      );
 
   };
 
+// while stop is TRUE, searches running in any thread are abandoned,
+// as if their deadline had passed.  used by another thread to cut a
+// search short.
+void StopSearches(BOOL stop);
+
+// finds the legal move by the given color on the board that is
+// written as text (in the notation of MoveText).  returns FALSE if
+// there is none.
+BOOL FindTextMove
+  (
+    const BOARD &board,
+    PIECECOLOR color,
+    const char *text,
+    PIECEMOVE &move
+  );
+
+// do a legal move by the given color on the board, without keeping
+// what is needed to undo it
+void DoPieceMove(BOARD &board, PIECECOLOR color, const PIECEMOVE &move);
+
 // list of possible ending positions if a piece is moved from a fixed
 // starting positions
 class POSITIONLIST
@@ -290,6 +683,10 @@ class PIECE
       { }
     virtual ~PIECE(void) { }
 
+    // returns a copy of the piece allocated on the heap, or null if
+    // out of memory
+    virtual PIECE *clone(void) const = 0;
+
     PIECECOLOR whatColor(void) const { return(color); }
 
     virtual PIECETYPE whatType(void) const { return(type); }
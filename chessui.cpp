@@ -205,7 +205,8 @@ const int NOINDEX = 1;
 const char *thinking[] =
   {
     (char *) 0,
-    " Player thinking, please wait...",
+    " Player thinking, please wait...  Hit the 'M' key to have it move"
+    " now.",
     (char *) 0
   };
 const int THINKINGCOLORINDEX = 0;
@@ -290,6 +291,8 @@ void CHESSUSERIFACE::init(const BOARD &board)
               );
         }
 
+    ChessCharUI.flush();
+
     return;
   }
 
@@ -364,6 +367,7 @@ BOOL CHESSUSERIFACE::userMove(BOARD &board, PIECECOLOR color)
                       POSITION(2, start.col),
                       pieceAbbrev(color, TYPEKING)
                     );
+                  ChessCharUI.flush();
                   return(TRUE);
                 }
             }
@@ -391,6 +395,7 @@ BOOL CHESSUSERIFACE::userMove(BOARD &board, PIECECOLOR color)
                       POSITION(6, start.col),
                       pieceAbbrev(color, TYPEKING)
                     );
+                  ChessCharUI.flush();
                   return(TRUE);
                 }
             }
@@ -459,6 +464,7 @@ BOOL CHESSUSERIFACE::userMove(BOARD &board, PIECECOLOR color)
       }
     ChessCharUI.clearSelect(end);
 
+    ChessCharUI.flush();
     return(TRUE);
   }
 
@@ -468,13 +474,37 @@ void CHESSUSERIFACE::thinkingMessage(PIECECOLOR color)
 
     ChessCharUI.showMessage(thinking);
 
+    ChessCharUI.flush();
+
     return;
   }
 
+// keys the user can press while the computer is thinking
+const char thinkingKeys[] = "mM";
+
+// time to wait for a key each time thinkingKey is called, in
+// milliseconds
+const int THINKINGPOLLTIME = 100;
+
+THINKREQUEST CHESSUSERIFACE::thinkingKey(void)
+  {
+    uint keyIndex;
+
+    if (!ChessCharUI.pollKey(THINKINGPOLLTIME, thinkingKeys, &keyIndex))
+      return(THINKQUIT);
+
+    if (thinkingKeys[keyIndex])
+      return(THINKMOVENOW);
+
+    return(THINKCONTINUE);
+  }
+
 void CHESSUSERIFACE::clearMessage(void)
   {
     ChessCharUI.clearMessage();
 
+    ChessCharUI.flush();
+
     return;
   }
 
@@ -512,6 +542,7 @@ BOOL CHESSUSERIFACE::computerMove
           return(FALSE);
         ChessCharUI.clearSelect(POSITION(5, backCol));
         ChessCharUI.clearSelect(POSITION(6, backCol));
+        ChessCharUI.flush();
         return(TRUE);
         
       case QUEENSIDECASTLE:
@@ -536,6 +567,7 @@ BOOL CHESSUSERIFACE::computerMove
           return(FALSE);
         ChessCharUI.clearSelect(POSITION(3, backCol));
         ChessCharUI.clearSelect(POSITION(2, backCol));
+        ChessCharUI.flush();
         return(TRUE);
         
       case NORMALMOVE:
@@ -613,6 +645,7 @@ BOOL CHESSUSERIFACE::computerMove
         ChessCharUI.clearSelect(moveInfo.start);
         ChessCharUI.clearSelect(moveInfo.end);
 
+        ChessCharUI.flush();
         return(TRUE);
 
       } // end of switch
@@ -23,6 +23,9 @@ SOFTWARE.
 #include "misc.hpp"
 #include "chess.hpp"
 
+// what the user asks for while the computer is thinking
+enum THINKREQUEST { THINKCONTINUE, THINKMOVENOW, THINKQUIT };
+
 // highest layer of user interface
 class CHESSUSERIFACE
   {
@@ -42,6 +45,9 @@ class CHESSUSERIFACE
     // tell the user the player of the given color is thinking about
     // their next move
     CLASSMEMBER void thinkingMessage(PIECECOLOR color);
+    // while the computer is thinking, wait a short time for the user
+    // to press a key, and return what the user asked for
+    CLASSMEMBER THINKREQUEST thinkingKey(void);
     // clear the last Message
     CLASSMEMBER void clearMessage(void);
     // display a move that has been selected by the computer.
@@ -18,15 +18,58 @@ SOFTWARE.
 */
 
 #include <limits.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
 
 #include "brdsize.hpp"
 #include "chess.hpp"
 #include "cplayer.hpp"
 #include "chessui.hpp"
+#include "book.hpp"
+#include "tbase.hpp"
+
+extern void OutOfMemory(void);
+
+FILE *SearchLog;
+
+// write the statistics of a look-ahead to the search log
+LOCAL void logSearch(PIECECOLOR color, const SEARCHSTATS &stats)
+  {
+    int i, last;
+
+    if (!SearchLog)
+      return;
+
+    fprintf(SearchLog,
+            "%s look-ahead %d%s: %llu positions in %.3f s, branching "
+            "factor %.2f\n",
+            color == WHITE ? "white" : "black", stats.lookAhead,
+            stats.abandoned ? " (abandoned)" : "", stats.total(),
+            stats.time / 1000000.0, stats.branchingFactor());
+
+    last = stats.lookAhead < MAXSTATSLOOKAHEAD ? stats.lookAhead :
+                                                 MAXSTATSLOOKAHEAD;
+    fprintf(SearchLog, "  positions after each move:");
+    for (i = 0; i < last; i++)
+      fprintf(SearchLog, " %llu", stats.nodes[i]);
+    fprintf(SearchLog, "\n");
+
+    fprintf(SearchLog,
+            "  leaves %llu, captures after last move %llu, table hits "
+            "%llu, promotions %llu, castles %llu\n",
+            stats.leaves, stats.quiesceNodes, stats.tableHits,
+            stats.promotions, stats.castles);
+
+    fflush(SearchLog);
+
+    return;
+  }
 
 // returns a measurement of how much of the board is "covered" by
 // the pieces of a given player.  lots of extra points are given
-// for "covering" the location around the opponent's king
+// for "covering" the location around the opponent's king.  the
+// board must be tracking attacks.
 LOCAL int coverage
   (
     const BOARD &board,
@@ -34,71 +77,16 @@ LOCAL int coverage
     POSITION whereEnemyKing
   )
   {
-    unsigned char map[NUMROWS][NUMCOLS];
-    // bit flags for elements of map
-    const unsigned char KINGAREA = 1;
-    const unsigned char COVERED = 2;
-    POSITION where;
-    POSITIONLIST moves;
-    int m, result = 0;
-
-    // initialize map
-    for (where.row = 0; where.row < NUMROWS; where.row++)
-      for (where.col = 0; where.col < NUMCOLS; where.col++)
-        map[where.row][where.col] = 0;
-
-    // set covered flag on all covered locations
-    for (where.row = 0; where.row < NUMROWS; where.row++)
-      for (where.col = 0; where.col < NUMCOLS; where.col++)
-        {
-          if (board.whatPiece(where))
-            if ((board.whatPiece(where)->whatColor() == color) &&
-                (board.whatPiece(where)->whatType() != TYPEPAWN))
-              {
-                board.whatPiece(where)->legalMoves(where, board, moves);
-                for (m = 0; m < moves.nMoves; m++)
-                  map[moves.end[m].row][moves.end[m].col] = COVERED;
-              }
-        }
-
-    // flag locations to which enemy king could move
-    board.whatPiece(whereEnemyKing)->
-      legalMoves(whereEnemyKing, board, moves);
-    for (m = 0; m < moves.nMoves; m++)
-      map[moves.end[m].row][moves.end[m].col] |= KINGAREA;
-
-    // accumulate coverage points
-    for (where.row = 0; where.row < NUMROWS; where.row++)
-      for (where.col = 0; where.col < NUMCOLS; where.col++)
-        {
-          if (map[where.row][where.col] & COVERED)
-            {
-              if (map[where.row][where.col] & KINGAREA)
-                result += 20;
-              else
-                result += 1;
-            }
-        }
-
-    return(result);
-  }
-
-LOCAL POSITION whereKing
-  (
-    const BOARD &board,
-    PIECECOLOR color
-  )
-  {
-    POSITION where;
-
-    for (where.row = 0; ; where.row++)
-      for (where.col = 0; where.col < NUMCOLS; where.col++)
-        {
-          if (board.whatPiece(where))
-            if (board.whatPiece(where)->whatColor() == color)
-              if (board.whatPiece(where)->whatType() == TYPEKING)
-                return(where);
-        }
+    // all covered locations, and the locations to which the enemy king
+    // could move
+    BITBOARD covered = board.attacksFrom(board.whatPieces(color) &
+                                         ~board.whatPieces(color, TYPEPAWN)) &
+                       ~board.whatPieces(color);
+    BITBOARD kingArea = board.attacksFrom(whereEnemyKing) &
+                        ~board.whatPieces(OtherColor(color));
+
+    return(CountPositions(covered & ~kingArea) +
+           (CountPositions(covered & kingArea) * 20));
   }
 
 // positive difference between two integers
@@ -139,6 +127,81 @@ LOCAL int threatChange
            oneDimHowClose(start.col, end.col, goal.col));
   }
 
+// cache of the development metrics of moves already measured, indexed
+// by the hash key of the position before the move (with the color to
+// move) combined with the move.  the metric depends only on the
+// position and the move, so a move from a position seen before, such
+// as one reached again or pondered on, need not be measured again.
+// as with the transposition table, the key is stored exclusive or'ed
+// with the metric, so an entry half written by another thread will
+// not match.
+class DEVCACHEENTRY
+  {
+  public:
+    std::atomic<HASHKEY> check;
+    std::atomic<HASHKEY> metric;
+  };
+
+// number of entries, must be a power of 2
+const int DEVCACHEENTRIES = 1 << 14;
+
+LOCAL DEVCACHEENTRY devCache[DEVCACHEENTRIES];
+
+// number of development metrics found in, and not found in, the cache
+LOCAL std::atomic<unsigned long long> devCacheHits, devCacheMisses;
+
+// key in the cache of a move from the position with the given key
+LOCAL inline HASHKEY devCacheKey
+  (
+    HASHKEY positionKey,
+    const PIECEMOVE &move
+  )
+  {
+    // spread the move over all the bits of the key
+    return(positionKey ^
+           ((((HASHKEY) PositionIndex(move.start) * NUMROWS * NUMCOLS +
+              PositionIndex(move.end)) * (TYPENOPIECE + 1) +
+             move.promoteType + 1) * 0x9E3779B97F4A7C15ULL));
+  }
+
+// the development metric of a move:  the value of the piece captured,
+// the coverage after the move, and the change in threat to the enemy
+// king.  the board must be tracking attacks.
+LOCAL int developMetric
+  (
+    BOARD &board,
+    PIECECOLOR moveColor,
+    POSITION whereEnemyKing,
+    const PIECEMOVE &move
+  )
+  {
+    MOVEUNDODATA undoData;
+    int metric;
+
+    board.doMove(move.start, move.end, undoData);
+
+    if (move.promoteType != TYPENOPIECE)
+      board.promote(move.end, move.promoteType);
+
+    metric = undoData.capturedPiece ?
+             undoData.capturedPiece->whatValue() * 16 : 0;
+    metric += coverage(board, moveColor, whereEnemyKing) +
+              threatChange
+                (
+                  move.start,
+                  move.end,
+                  whereEnemyKing,
+                  board.whatPiece(move.end)
+                ) * 4;
+
+    if (move.promoteType != TYPENOPIECE)
+      board.restorePawn(move.end);
+
+    board.undoMove(move.end, move.start, undoData);
+
+    return(metric);
+  }
+
 // for a given list of moves, find the one that best improves the
 // "development" of a player's pieces.  development is a combination
 // of covering alot of the board, getting pieces close to the enemy's
@@ -150,91 +213,434 @@ LOCAL int bestDevelopMove
     BESTMOVES &bestMoves
   )
   {
-    POSITION whereEnemyKing = whereKing(board, OtherColor(moveColor));
+    POSITION whereEnemyKing = board.whereKing(OtherColor(moveColor));
+    HASHKEY positionKey = board.whatHashKey(moveColor);
+    HASHKEY key, check, stored;
     int testMetric, bestMetric = INT_MIN;
     int bestIndex, testIndex;
-    MOVEUNDODATA undoData;
+
+    // engage in castlephilia
+    for (testIndex = 0; testIndex < bestMoves.nMoves; testIndex++)
+      if (bestMoves.move[testIndex].type != NORMALMOVE)
+        return(testIndex);
+
+    board.trackAttacks(TRUE);
 
     for (testIndex = 0; testIndex < bestMoves.nMoves; testIndex++)
       {
-        // engage in castlephilia
-        if (bestMoves.move[testIndex].type != NORMALMOVE)
-          return(testIndex);
-
-        board.doMove
-          (
-            bestMoves.move[testIndex].start,
-            bestMoves.move[testIndex].end,
-            undoData
-          );
-
-        if (bestMoves.move[testIndex].promoteType != TYPENOPIECE)
-          board.promote(bestMoves.move[testIndex].end,
-                        bestMoves.move[testIndex].promoteType);
-
-        testMetric = undoData.capturedPiece ?
-                     undoData.capturedPiece->whatValue() * 16 : 0;
-        testMetric += coverage(board, moveColor, whereEnemyKing) +
-                      threatChange
-                        (
-                          bestMoves.move[testIndex].start,
-                          bestMoves.move[testIndex].end,
-                          whereEnemyKing,
-                          board.whatPiece(bestMoves.move[testIndex].end)
-                        ) * 4;
+        key = devCacheKey(positionKey, bestMoves.move[testIndex]);
+        DEVCACHEENTRY &entry = devCache[key & (DEVCACHEENTRIES - 1)];
+
+        check = entry.check.load(std::memory_order_relaxed);
+        stored = entry.metric.load(std::memory_order_relaxed);
+        if ((check ^ stored) == key)
+          {
+            devCacheHits++;
+            testMetric = (int) stored;
+          }
+        else
+          {
+            devCacheMisses++;
+            testMetric = developMetric(board, moveColor, whereEnemyKing,
+                                       bestMoves.move[testIndex]);
+            stored = (HASHKEY) (unsigned int) testMetric;
+            entry.check.store(key ^ stored, std::memory_order_relaxed);
+            entry.metric.store(stored, std::memory_order_relaxed);
+          }
 
         if (testMetric > bestMetric)
           {
             bestIndex = testIndex;
             bestMetric = testMetric;
           }
+      }
 
-        if (bestMoves.move[testIndex].promoteType != TYPENOPIECE)
-          board.restorePawn(bestMoves.move[testIndex].end);
+    board.trackAttacks(FALSE);
 
-        board.undoMove
-          (
-            bestMoves.move[testIndex].end,
-            bestMoves.move[testIndex].start,
-            undoData
-          );
+    return(bestIndex);
+  }
+
+int COMPUTERPLAYER::deepenSearch
+  (
+    BOARD &board,
+    BOARDMETRIC &metric,
+    BESTMOVES &bestMoves
+  ) const
+  {
+    CLOCKTIME start = ClockNow();
+    BOARDMETRIC testMetric;
+    BESTMOVES testMoves;
+    int testLookAhead, completed = 2;
+
+    // the shortest look-ahead is completed unless searches are
+    // stopped, so there is a move to make
+    board.findBestMoves(completed, whatColor(), metric, &bestMoves, TRUE);
+    logSearch(whatColor(), board.searchStats());
+    if (board.searchWasAbandoned())
+      return(0);
+
+    if (moveTime)
+      board.setDeadline(start + moveTime);
+
+    for (testLookAhead = completed + 1; testLookAhead <= lookAhead;
+         testLookAhead++)
+      {
+        if (moveTime)
+          {
+            // looking further ahead will not change a forced win or
+            // loss
+            if ((metric.kingSituation[WHITE] != KINGOK) ||
+                (metric.kingSituation[BLACK] != KINGOK))
+              break;
+
+            // each search takes several times as long as the last one,
+            // so don't start one that would not finish
+            if ((ClockNow() - start) > (moveTime / 2))
+              break;
+          }
+
+        board.findBestMoves(testLookAhead, whatColor(), testMetric,
+                            &testMoves, TRUE);
+        logSearch(whatColor(), board.searchStats());
+        if (board.searchWasAbandoned())
+          break;
+
+        metric = testMetric;
+        bestMoves = testMoves;
+        completed = testLookAhead;
       }
 
-    return(bestIndex);
+    board.setDeadline(0);
+
+    return(completed);
   }
 
-GAMESTATUS COMPUTERPLAYER::play(BOARD &board) const
+BOOL COMPUTERPLAYER::chooseMove(BOARD &board, PIECEMOVE &move) const
   {
     BOARDMETRIC metric;
     BESTMOVES bestMoves;
-    int best;
+    int plies;
 
-    ChessUI.thinkingMessage(whatColor());
-    board.findBestMoves(lookAhead, whatColor(), metric, &bestMoves);
-    if (metric.kingSituation[whatColor()] != KINGOK)
+    char text[MAXFENLENGTH];
+
+    if (SearchLog)
+      {
+        board.writeFen(whatColor(), text);
+        fprintf(SearchLog, "position %s\n", text);
+      }
+
+    if (BookMove(board, whatColor(), move))
       {
-        // see if checkmate/stalemate current or predicted
-        if (lookAhead > 2)
-          board.findBestMoves(2, whatColor(), metric, &bestMoves);
+        // no need to look ahead from a position in the opening book
+        if (SearchLog)
+          {
+            MoveText(whatColor(), move, text);
+            fprintf(SearchLog, "%s moves %s from the book\n\n",
+                    whatColor() == WHITE ? "white" : "black", text);
+            fflush(SearchLog);
+          }
+
+        return(TRUE);
+      }
 
-        if (metric.kingSituation[whatColor()] == KINGLOST)
+    if (TablebaseMove(board, whatColor(), move, plies))
+      {
+        // the result of the endgame is known exactly
+        if (SearchLog)
+          {
+            MoveText(whatColor(), move, text);
+            fprintf(SearchLog, "%s moves %s from the tablebase, ",
+                    whatColor() == WHITE ? "white" : "black", text);
+            if (plies)
+              fprintf(SearchLog, "%s in %d plies\n\n",
+                      plies > 0 ? "mates" : "is mated",
+                      plies > 0 ? plies : -plies);
+            else
+              fprintf(SearchLog, "draw\n\n");
+            fflush(SearchLog);
+          }
+
+        return(TRUE);
+      }
+
+    // the look-aheads are deepened one move at a time even without a
+    // time limit, so that if searches are stopped, the move found by
+    // the last complete one can be made
+    if (!deepenSearch(board, metric, bestMoves))
+      {
+        if (SearchLog)
           {
-            ChessUI.clearMessage();
-            ChessUI.mated(whatColor());
-            return(GAMEOVER);
+            fprintf(SearchLog, "%s stopped before choosing a move\n\n",
+                    whatColor() == WHITE ? "white" : "black");
+            fflush(SearchLog);
           }
-        else if (metric.kingSituation[whatColor()] == STALEMATE)
+
+        return(FALSE);
+      }
+
+    move = bestMoves.move[bestDevelopMove(board, whatColor(), bestMoves)];
+
+    if (SearchLog)
+      {
+        MoveText(whatColor(), move, text);
+        fprintf(SearchLog, "%s moves %s\n",
+                whatColor() == WHITE ? "white" : "black", text);
+        fprintf(SearchLog,
+                "  development metrics cached %llu, measured %llu\n\n",
+                devCacheHits.load(), devCacheMisses.load());
+        fflush(SearchLog);
+      }
+
+    return(TRUE);
+  }
+
+PIECEMOVE COMPUTERPLAYER::shortestMove(BOARD &board) const
+  {
+    BOARDMETRIC metric;
+    BESTMOVES bestMoves;
+    PIECEMOVE move;
+    char text[6];
+
+    board.setDeadline(0);
+    board.findBestMoves(2, whatColor(), metric, &bestMoves, TRUE);
+    logSearch(whatColor(), board.searchStats());
+
+    move = bestMoves.move[bestDevelopMove(board, whatColor(), bestMoves)];
+
+    if (SearchLog)
+      {
+        MoveText(whatColor(), move, text);
+        fprintf(SearchLog, "%s moves %s\n\n",
+                whatColor() == WHITE ? "white" : "black", text);
+        fflush(SearchLog);
+      }
+
+    return(move);
+  }
+
+// state shared by play and the thread that chooses the move
+class THINKING
+  {
+  public:
+    const COMPUTERPLAYER *player;
+    BOARD *board;
+    PIECEMOVE move;
+    // TRUE if move was chosen, FALSE if searches were stopped first
+    BOOL found;
+    // set when the thread is done
+    std::atomic<bool> done;
+    std::thread thread;
+  };
+
+// body of the thread that chooses the move
+LOCAL void think(THINKING *thinking)
+  {
+    thinking->found =
+      thinking->player->chooseMove(*thinking->board, thinking->move);
+    thinking->done.store(true);
+
+    return;
+  }
+
+// start a thread with the given body choosing the move for the player
+// from the board
+LOCAL void startThinking
+  (
+    THINKING &thinking,
+    const COMPUTERPLAYER *player,
+    BOARD *board,
+    void (*body)(THINKING *) = think
+  )
+  {
+    thinking.player = player;
+    thinking.board = board;
+    thinking.done.store(false);
+    thinking.thread = std::thread(body, &thinking);
+
+    return;
+  }
+
+// stop the searches of a thread choosing a move, and wait for it to
+// finish.  its move is not valid.
+LOCAL void stopThinking(THINKING &thinking)
+  {
+    StopSearches(TRUE);
+    thinking.thread.join();
+    StopSearches(FALSE);
+
+    return;
+  }
+
+// looking ahead on the opponent's time, from the position after the
+// move predicted for the opponent.  the board is a copy, owned by
+// the pondering.  null if no player is pondering.
+LOCAL THINKING *pondering;
+// hash key (with the color to move) of the position pondered, valid
+// once ponderPredicted is set
+LOCAL HASHKEY ponderKey;
+LOCAL std::atomic<bool> ponderPredicted;
+
+// body of the pondering thread.  it predicts the opponent's reply by
+// the shortest look-ahead, makes it on the (copied) board, then
+// chooses the move from the position after it.
+LOCAL void ponder(THINKING *thinking)
+  {
+    const COMPUTERPLAYER *player = thinking->player;
+    BOARD &board = *thinking->board;
+    PIECECOLOR color = player->whatColor(), opponent = OtherColor(color);
+    BOARDMETRIC metric;
+    BESTMOVES bestMoves;
+    char text[6];
+
+    thinking->found = FALSE;
+
+    board.findBestMoves(2, opponent, metric, &bestMoves, TRUE);
+
+    // if pondering was stopped, or the reply would leave the player
+    // with no legal move, there is nothing to look ahead at
+    if (!board.searchWasAbandoned())
+      {
+        DoPieceMove(board, opponent, bestMoves.move[0]);
+
+        if (board.kingSituation(color) == KINGOK)
           {
-            ChessUI.clearMessage();
-            ChessUI.staleMated(whatColor());
-            return(GAMEOVER);
+            ponderKey = board.whatHashKey(color);
+            ponderPredicted.store(true);
+
+            if (SearchLog)
+              {
+                MoveText(opponent, bestMoves.move[0], text);
+                fprintf(SearchLog, "pondering on the reply %s\n", text);
+              }
+
+            thinking->found = player->chooseMove(board, thinking->move);
           }
       }
 
-    best = bestDevelopMove(board, whatColor(), bestMoves);
+    thinking->done.store(true);
+
+    return;
+  }
+
+void COMPUTERPLAYER::startPondering(BOARD &board) const
+  {
+    BOARD *ponderBoard;
+
+    if (board.kingSituation(OtherColor(whatColor())) != KINGOK)
+      return;
+
+    if (!(ponderBoard = new BOARD(board)) ||
+        !(pondering = new THINKING))
+      OutOfMemory();
+
+    ponderPredicted.store(false);
+    startThinking(*pondering, this, ponderBoard, ponder);
+
+    return;
+  }
+
+void COMPUTERPLAYER::stopPondering(BOOL hit) const
+  {
+    if (!pondering || (pondering->player != this))
+      return;
 
-    if (!ChessUI.computerMove(board, whatColor(),
-                              bestMoves.move[best]))
+    if (!hit)
+      stopThinking(*pondering);
+
+    delete pondering->board;
+    delete pondering;
+    pondering = (THINKING *) 0;
+
+    return;
+  }
+
+COMPUTERPLAYER::~COMPUTERPLAYER(void)
+  {
+    stopPondering(FALSE);
+  }
+
+GAMESTATUS COMPUTERPLAYER::play(BOARD &board) const
+  {
+    THINKING ownThinking, *thinking = &ownThinking;
+    BOOL quit = FALSE, hit, found;
+    PIECEMOVE move;
+
+    // see if checkmate/stalemate current
+    switch (board.kingSituation(whatColor()))
+      {
+      case KINGLOST:
+        stopPondering(FALSE);
+        ChessUI.mated(whatColor());
+        return(GAMEOVER);
+
+      case STALEMATE:
+        stopPondering(FALSE);
+        ChessUI.staleMated(whatColor());
+        return(GAMEOVER);
+
+      case KINGOK:
+        break;
+      }
+
+    ChessUI.thinkingMessage(whatColor());
+
+    hit = pondering && (pondering->player == this) &&
+          ponderPredicted.load() &&
+          (ponderKey == board.whatHashKey(whatColor()));
+
+    if (SearchLog && pondering && (pondering->player == this))
+      fprintf(SearchLog, "ponder %s\n", hit ? "hit" : "miss");
+
+    if (hit)
+      // the opponent made the predicted move, so the look-ahead from
+      // the position is already under way, or finished
+      thinking = pondering;
+    else
+      {
+        stopPondering(FALSE);
+
+        // look ahead in another thread, so the user can stop it
+        startThinking(ownThinking, this, &board);
+      }
+
+    // only this thread stops and restarts searches
+    while (!thinking->done.load())
+      switch (ChessUI.thinkingKey())
+        {
+        case THINKCONTINUE:
+          break;
+
+        case THINKMOVENOW:
+          StopSearches(TRUE);
+          break;
+
+        case THINKQUIT:
+          StopSearches(TRUE);
+          quit = TRUE;
+          break;
+        }
+
+    thinking->thread.join();
+    StopSearches(FALSE);
+
+    found = thinking->found;
+    move = thinking->move;
+    if (hit)
+      stopPondering(TRUE);
+
+    if (quit)
       return(GAMEOVER);
+
+    if (!found)
+      // searches were stopped before any look-ahead was completed, so
+      // make the move found by the shortest one
+      move = shortestMove(board);
+
+    if (!ChessUI.computerMove(board, whatColor(), move))
+      return(GAMEOVER);
+
+    if (ponders)
+      startPondering(board);
+
     return(GAMECONTINUE);
   }
@@ -20,22 +20,72 @@ SOFTWARE.
 #if !defined(CPLAYER_HPP)
 #define CPLAYER_HPP
 
+#include <stdio.h>
+
 #include "chess.hpp"
 #include "player.hpp"
 
+// most moves a computer player with a time limit will look ahead
+const int MAXLOOKAHEAD = 30;
+
+// if not null, the file the statistics of each look-ahead done by the
+// computer players are written to
+extern FILE *SearchLog;
+
 // player whose moves are chosen by the computer
 class COMPUTERPLAYER : public PLAYER
   {
   private:
-    // number of moves to look ahead when chosing the next move
+    // number of moves to look ahead when chosing the next move.  if
+    // there is a time limit, the most moves to look ahead.
     const int lookAhead;
+    // if not 0, the time limit for chosing a move
+    const CLOCKTIME moveTime;
+    // if TRUE, the player looks ahead while the opponent is choosing
+    // their move
+    const BOOL ponders;
+
+    // look ahead 2 moves, then 3, and so on up to lookAhead, or until
+    // the time limit for chosing the move (if any) is used up.
+    // returns the number of moves of look-ahead of the last complete
+    // search, whose results are returned, or 0 if searches were
+    // stopped before the first one was complete.
+    int deepenSearch
+      (
+        BOARD &board,
+        BOARDMETRIC &metric,
+        BESTMOVES &bestMoves
+      ) const;
+
+    // start a thread that predicts the opponent's reply to the move
+    // just made on the board, and looks ahead from the position after
+    // it, on a copy of the board.  the results are used by play if
+    // the opponent makes the predicted move.
+    void startPondering(BOARD &board) const;
+
+    // end the pondering of this player, if any.  if hit is FALSE, the
+    // look-ahead is abandoned first, otherwise it must have finished.
+    void stopPondering(BOOL hit) const;
+
+    // look ahead 2 moves from the board, which can't be stopped, and
+    // return the move that would be made.  used when searches were
+    // stopped before chooseMove completed any look-ahead.
+    PIECEMOVE shortestMove(BOARD &board) const;
 
   public:
-    COMPUTERPLAYER(PIECECOLOR color, int lA) :
-      PLAYER(color), lookAhead(lA) { }
+    COMPUTERPLAYER(PIECECOLOR color, int lA, CLOCKTIME mT = 0,
+                   BOOL p = FALSE) :
+      PLAYER(color), lookAhead(lA), moveTime(mT), ponders(p) { }
+    virtual ~COMPUTERPLAYER(void);
 
     virtual GAMESTATUS play(BOARD &board) const;
 
+    // look ahead from the board, and return TRUE with the move that
+    // would be made.  the player must have a legal move.  if searches
+    // are stopped (by StopSearches), the move found by the last
+    // complete look-ahead is returned, or FALSE if none was complete.
+    BOOL chooseMove(BOARD &board, PIECEMOVE &move) const;
+
   };
 
 #endif
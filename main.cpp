@@ -17,6 +17,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -25,6 +26,11 @@ SOFTWARE.
 #include "uplayer.hpp"
 #include "cplayer.hpp"
 #include "chessui.hpp"
+#include "thrdpool.hpp"
+#include "perft.hpp"
+#include "bench.hpp"
+#include "book.hpp"
+#include "tbase.hpp"
 
 void OutOfMemory(void)
   {
@@ -33,14 +39,27 @@ void OutOfMemory(void)
   }
 
 // define a player based on a command line parameter.  player
-// is allocated on heap.
-LOCAL PLAYER *defPlayer(PIECECOLOR color, const char *arg)
+// is allocated on heap.  a computer player ponders (looks ahead on
+// the opponent's time) if ponder is TRUE.
+LOCAL PLAYER *defPlayer(PIECECOLOR color, const char *arg, BOOL ponder)
   {
     BOOL computer = TRUE;
     int lookAhead;
+    CLOCKTIME moveTime = 0;
+    double seconds;
+    char *end;
     PLAYER *player;
 
-    if (strcasecmp(arg, "u") == 0)
+    if ((arg[0] == 't') || (arg[0] == 'T'))
+      {
+        // time limit in seconds for each move
+        seconds = strtod(arg + 1, &end);
+        if ((end == (arg + 1)) || *end || !(seconds > 0))
+          exit(1);
+        moveTime = (CLOCKTIME) (seconds * 1000000);
+        lookAhead = MAXLOOKAHEAD;
+      }
+    else if (strcasecmp(arg, "u") == 0)
       computer = FALSE;
     else if (strcasecmp(arg, "c1") == 0)
       lookAhead = 2;
@@ -58,7 +77,7 @@ LOCAL PLAYER *defPlayer(PIECECOLOR color, const char *arg)
       exit(1);
 
     if (computer)
-      player = new COMPUTERPLAYER(color, lookAhead);
+      player = new COMPUTERPLAYER(color, lookAhead, moveTime, ponder);
     else
       player = new USERPLAYER(color);
 
@@ -69,6 +88,51 @@ LOCAL PLAYER *defPlayer(PIECECOLOR color, const char *arg)
   }
 
 
+// if not null, the position to start from, in FEN
+LOCAL const char *startFen;
+
+// handle a command line option (an argument starting with '-')
+LOCAL void doOption(const char *arg)
+  {
+    long n;
+    char *end;
+
+    if (arg[1] == 'j')
+      {
+        // number of threads for the computer player's look-ahead
+        n = strtol(arg + 2, &end, 10);
+        if ((end == (arg + 2)) || *end || (n < 1) || (n > MAXTHREADS))
+          exit(1);
+        SearchThreads.setThreads((int) n);
+      }
+    else if (arg[1] == 'f')
+      // position to start from
+      startFen = arg + 2;
+    else if (arg[1] == 'b')
+      {
+        // opening book
+        if (!OpenBook(arg + 2))
+          {
+            fprintf(stderr, "Cannot use opening book %s\n", arg + 2);
+            exit(1);
+          }
+      }
+    else if (arg[1] == 't')
+      // directory of endgame tablebases
+      SetTablebaseDir(arg + 2);
+    else if (arg[1] == 'l')
+      {
+        // file to log the computer player's look-aheads in
+        SearchLog = fopen(arg + 2, "w");
+        if (!SearchLog)
+          exit(1);
+      }
+    else
+      exit(1);
+
+    return;
+  }
+
 // define the two players based on command line arguments (or
 // defaults)
 LOCAL void setupPlayers
@@ -80,39 +144,165 @@ LOCAL void setupPlayers
   )
   {
     const char *white = "u", *black = "c2";
+    int i, nPlayers = 0;
 
-    if (nArg > 1)
-      white = arg[1];
-    if (nArg > 2)
-      black = arg[2];
-    if (nArg > 3)
-      exit(1);
+    for (i = 1; i < nArg; i++)
+      if (arg[i][0] == '-')
+        doOption(arg[i]);
+      else
+        {
+          if (nPlayers == 0)
+            white = arg[i];
+          else if (nPlayers == 1)
+            black = arg[i];
+          else
+            exit(1);
+          nPlayers++;
+        }
 
-    whitePlayer = defPlayer(WHITE, white);
-    blackPlayer = defPlayer(BLACK, black);
+    // a computer player only ponders while the user is choosing a
+    // move, so that two look-aheads never run at the same time
+    whitePlayer = defPlayer(WHITE, white, strcasecmp(black, "u") == 0);
+    blackPlayer = defPlayer(BLACK, black, strcasecmp(white, "u") == 0);
 
     return;
   }
 
+// set up the board from the position given by the -f option, if
+// any, and return the color to move
+LOCAL PIECECOLOR startColor(BOARD &board)
+  {
+    PIECECOLOR color = WHITE;
+
+    if (startFen && !board.readFen(startFen, color))
+      {
+        fprintf(stderr, "Invalid position:  %s\n", startFen);
+        exit(1);
+      }
+
+    return(color);
+  }
+
+// print the number of positions reached by all sequences of the
+// given number of moves from the starting position, for the command
+// line "chess perft <depth>".  the option -h<megabytes> gives the size
+// of a table to save counts in.
+LOCAL int perftMode(int nArg, char **arg)
+  {
+    BOARD board;
+    long depth = 0, megabytes;
+    char *end;
+    int i;
+
+    for (i = 2; i < nArg; i++)
+      if ((arg[i][0] == '-') && (arg[i][1] == 'h'))
+        {
+          // megabytes for the table of counts
+          megabytes = strtol(arg[i] + 2, &end, 10);
+          if ((end == (arg[i] + 2)) || *end || (megabytes < 0) ||
+              (megabytes > 65536))
+            exit(1);
+          SetPerftTable((int) megabytes);
+        }
+      else if (arg[i][0] == '-')
+        doOption(arg[i]);
+      else if (depth == 0)
+        {
+          depth = strtol(arg[i], &end, 10);
+          if ((end == arg[i]) || *end || (depth < 1))
+            exit(1);
+        }
+      else
+        exit(1);
+
+    if (depth == 0)
+      exit(1);
+
+    PerftDivide(board, startColor(board), (int) depth);
+
+    return(0);
+  }
+
+// time the computer player choosing moves in a fixed set of
+// positions, for the command line "chess bench [look-ahead]".  the
+// default look-ahead is that of skill level 3.
+LOCAL int benchMode(int nArg, char **arg)
+  {
+    long lookAhead = 0;
+    char *end;
+    int i;
+
+    for (i = 2; i < nArg; i++)
+      if (arg[i][0] == '-')
+        doOption(arg[i]);
+      else if (lookAhead == 0)
+        {
+          lookAhead = strtol(arg[i], &end, 10);
+          if ((end == arg[i]) || *end || (lookAhead < 1) ||
+              (lookAhead > MAXLOOKAHEAD))
+            exit(1);
+        }
+      else
+        exit(1);
+
+    Bench(lookAhead ? (int) lookAhead : 4);
+
+    return(0);
+  }
+
+// make an opening book, for the command line
+// "chess makebook <lines-file> <book-file>"
+LOCAL int makeBookMode(int nArg, char **arg)
+  {
+    if (nArg != 4)
+      exit(1);
+
+    return(MakeBook(arg[2], arg[3]) ? 0 : 1);
+  }
+
+// make endgame tablebases, for the command line
+// "chess maketb <directory> <endgame> ..."
+LOCAL int makeTablebaseMode(int nArg, char **arg)
+  {
+    int i;
+
+    if (nArg < 4)
+      exit(1);
+
+    SetTablebaseDir(arg[2]);
+
+    for (i = 3; i < nArg; i++)
+      if (!MakeTablebase(arg[i]))
+        return(1);
+
+    return(0);
+  }
+
 int main(int nArg, char **arg)
   {
     BOARD board;
-    PLAYER *whitePlayer, *blackPlayer;
+    PLAYER *player[2];
+    PIECECOLOR color;
 
-    setupPlayers(nArg, arg, whitePlayer, blackPlayer);
+    if ((nArg > 1) && (strcasecmp(arg[1], "perft") == 0))
+      return(perftMode(nArg, arg));
+    if ((nArg > 1) && (strcasecmp(arg[1], "bench") == 0))
+      return(benchMode(nArg, arg));
+    if ((nArg > 1) && (strcasecmp(arg[1], "makebook") == 0))
+      return(makeBookMode(nArg, arg));
+    if ((nArg > 1) && (strcasecmp(arg[1], "maketb") == 0))
+      return(makeTablebaseMode(nArg, arg));
+
+    setupPlayers(nArg, arg, player[WHITE], player[BLACK]);
+    color = startColor(board);
 
     ChessUI.init(board);
 
-    for ( ; ; )
-      {
-        if (whitePlayer->play(board) == GAMEOVER)
-          break;
-        if (blackPlayer->play(board) == GAMEOVER)
-          break;
-      }
+    while (player[color]->play(board) != GAMEOVER)
+      color = OtherColor(color);
 
-    delete whitePlayer;
-    delete blackPlayer;
+    delete player[WHITE];
+    delete player[BLACK];
 
     return(0);
   }
@@ -20,6 +20,8 @@ SOFTWARE.
 #if !defined(MISC_HPP)
 #define MISC_HPP
 
+#include <time.h>
+
 #define uint unsigned int
 
 typedef int BOOL;
@@ -33,4 +35,17 @@ const int TRUE = 1, FALSE = 0;
 // returns number of elements in array AA of any type elements
 #define ARRAY_LENGTH(AA) (sizeof(AA) / sizeof((AA)[0]))
 
+// a time, in microseconds
+typedef long long CLOCKTIME;
+
+// returns the current time of a clock that is never set back
+inline CLOCKTIME ClockNow(void)
+  {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return(((CLOCKTIME) t.tv_sec * 1000000) + (t.tv_nsec / 1000));
+  }
+
 #endif
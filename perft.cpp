@@ -0,0 +1,272 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <atomic>
+
+#include "misc.hpp"
+#include "brdsize.hpp"
+#include "chess.hpp"
+#include "thrdpool.hpp"
+#include "perft.hpp"
+
+extern void OutOfMemory(void);
+
+// an entry of the table of counts.  as in the transposition table of
+// the look-ahead, the key is stored exclusive or'ed with the data, so
+// an entry half written by one thread while another reads it will not
+// match the key.
+class PERFTENTRY
+  {
+  public:
+    // hash key of position (including color to move) ^ data
+    std::atomic<HASHKEY> check;
+    // count in the high bits, depth in the low 8 bits
+    std::atomic<HASHKEY> data;
+  };
+
+LOCAL PERFTENTRY *perftTable;
+// number of entries in the table, a power of 2
+LOCAL HASHKEY perftTableSize;
+
+void SetPerftTable(int megabytes)
+  {
+    HASHKEY size = 1;
+
+    if (perftTable)
+      {
+        delete [] perftTable;
+        perftTable = (PERFTENTRY *) 0;
+      }
+
+    if (megabytes <= 0)
+      return;
+
+    while ((size * 2 * sizeof(PERFTENTRY)) <=
+           ((HASHKEY) megabytes << 20))
+      size *= 2;
+
+    perftTable = new PERFTENTRY[size];
+    if (!perftTable)
+      OutOfMemory();
+    perftTableSize = size;
+
+    for (size = 0; size < perftTableSize; size++)
+      {
+        perftTable[size].check.store(0, std::memory_order_relaxed);
+        perftTable[size].data.store(0, std::memory_order_relaxed);
+      }
+
+    return;
+  }
+
+// fill in the list of all the legal moves for the given color,
+// including castles and promotions to a rook or bishop
+LOCAL void allMoves
+  (
+    const BOARD &board,
+    PIECECOLOR color,
+    MOVELIST &list
+  )
+  {
+    int m, n;
+
+    board.listMoves(color, list, FALSE);
+
+    // listMoves only promotes to a queen or a knight
+    n = list.nMoves;
+    for (m = 0; m < n; m++)
+      if (list.move[m].promoteType == TYPEQUEEN)
+        {
+          list.move[list.nMoves] = list.move[m];
+          list.move[list.nMoves++].promoteType = TYPEROOK;
+          list.move[list.nMoves] = list.move[m];
+          list.move[list.nMoves++].promoteType = TYPEBISHOP;
+        }
+
+    if (board.userCanCastle(QUEENSIDECASTLE, color))
+      list.move[list.nMoves++] = PIECEMOVE(QUEENSIDECASTLE);
+    if (board.userCanCastle(KINGSIDECASTLE, color))
+      list.move[list.nMoves++] = PIECEMOVE(KINGSIDECASTLE);
+
+    return;
+  }
+
+// do a move from a list made by allMoves
+LOCAL void doListedMove
+  (
+    BOARD &board,
+    PIECECOLOR color,
+    const PIECEMOVE &move,
+    MOVEUNDODATA &undoData
+  )
+  {
+    if (move.type != NORMALMOVE)
+      board.castle(move.type, color, undoData);
+    else
+      {
+        board.doMove(move.start, move.end, undoData);
+        if (move.promoteType != TYPENOPIECE)
+          board.promote(move.end, move.promoteType);
+      }
+
+    return;
+  }
+
+// undo a move done by doListedMove
+LOCAL void undoListedMove
+  (
+    BOARD &board,
+    PIECECOLOR color,
+    const PIECEMOVE &move,
+    MOVEUNDODATA &undoData
+  )
+  {
+    if (move.type != NORMALMOVE)
+      board.undoCastle(move.type, color, undoData);
+    else
+      {
+        if (move.promoteType != TYPENOPIECE)
+          board.restorePawn(move.end);
+        board.undoMove(move.end, move.start, undoData);
+      }
+
+    return;
+  }
+
+unsigned long long Perft(BOARD &board, PIECECOLOR color, int depth)
+  {
+    MOVELIST moves;
+    MOVEUNDODATA undoData;
+    unsigned long long count = 0;
+    HASHKEY key = 0, check, data;
+    PERFTENTRY *entry = (PERFTENTRY *) 0;
+    int m;
+
+    if (depth == 0)
+      return(1);
+
+    // counts of one move are quicker to make than to look up
+    if (perftTable && (depth > 1))
+      {
+        key = board.whatHashKey(color);
+        entry = perftTable + (key & (perftTableSize - 1));
+        check = entry->check.load(std::memory_order_relaxed);
+        data = entry->data.load(std::memory_order_relaxed);
+        if (((check ^ data) == key) && ((int) (data & 0xFF) == depth))
+          return(data >> 8);
+      }
+
+    allMoves(board, color, moves);
+
+    // the positions after the last move don't need to be visited
+    if (depth == 1)
+      return(moves.nMoves);
+
+    for (m = 0; m < moves.nMoves; m++)
+      {
+        doListedMove(board, color, moves.move[m], undoData);
+        count += Perft(board, OtherColor(color), depth - 1);
+        undoListedMove(board, color, moves.move[m], undoData);
+      }
+
+    if (entry)
+      {
+        data = (count << 8) | (HASHKEY) depth;
+        entry->check.store(key ^ data, std::memory_order_relaxed);
+        entry->data.store(data, std::memory_order_relaxed);
+      }
+
+    return(count);
+  }
+
+// state shared by the threads counting from the first moves
+class PERFTSPLIT
+  {
+  public:
+    const BOARD *board;
+    PIECECOLOR color;
+    int depth;
+    MOVELIST moves;
+    // index in moves of the next move for a thread to count from
+    std::atomic<int> nextMove;
+    // the count from each move
+    unsigned long long count[MAXPIECES * MAXMOVES];
+  };
+
+// job run by each thread of SearchThreads
+LOCAL void perftJob(void *arg, int /* thread */)
+  {
+    PERFTSPLIT &split = *(PERFTSPLIT *) arg;
+    BOARD board(*split.board);
+    MOVEUNDODATA undoData;
+    int m;
+
+    for ( ; ; )
+      {
+        m = split.nextMove++;
+        if (m >= split.moves.nMoves)
+          break;
+
+        doListedMove(board, split.color, split.moves.move[m], undoData);
+        split.count[m] = Perft(board, OtherColor(split.color),
+                               split.depth - 1);
+        undoListedMove(board, split.color, split.moves.move[m], undoData);
+      }
+
+    return;
+  }
+
+void PerftDivide(const BOARD &board, PIECECOLOR color, int depth)
+  {
+    PERFTSPLIT *split = new PERFTSPLIT;
+    unsigned long long total = 0;
+    CLOCKTIME start = ClockNow(), elapsed;
+    char text[6];
+    int m;
+
+    if (!split)
+      OutOfMemory();
+
+    split->board = &board;
+    split->color = color;
+    split->depth = depth;
+    allMoves(board, color, split->moves);
+    split->nextMove = 0;
+
+    SearchThreads.run(perftJob, split);
+
+    for (m = 0; m < split->moves.nMoves; m++)
+      {
+        MoveText(color, split->moves.move[m], text);
+        printf("%s: %llu\n", text, split->count[m]);
+        total += split->count[m];
+      }
+
+    elapsed = ClockNow() - start;
+
+    printf("\nmoves: %d\nnodes: %llu\ntime: %.3f s\n", split->moves.nMoves,
+           total, elapsed / 1000000.0);
+    if (elapsed > 0)
+      printf("nodes/second: %.0f\n", total * 1000000.0 / elapsed);
+
+    delete split;
+
+    return;
+  }
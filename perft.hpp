@@ -0,0 +1,46 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#if !defined(PERFT_HPP)
+#define PERFT_HPP
+
+#include "chess.hpp"
+
+// returns the number of positions reached by every sequence of depth
+// legal moves, starting with the given color to move.  every kind of
+// promotion is counted, not only the ones the look-ahead tries.  used
+// to check the moves found by BOARD against known counts, and to time
+// finding and doing the moves apart from the look-ahead.
+unsigned long long Perft(BOARD &board, PIECECOLOR color, int depth);
+
+// prints the count for each first move (the "divide" of the count), so
+// that a wrong count can be traced to the move it comes from, then the
+// total count, the time taken and the positions per second.  the
+// first moves are shared out among the threads of SearchThreads, each
+// counting from its own copy of the board.
+void PerftDivide(const BOARD &board, PIECECOLOR color, int depth);
+
+// use a table of about the given number of megabytes (0 for none) to
+// save the counts from positions, indexed by the hash key of the
+// position, so that the count from a position reached by more than
+// one order of moves is only made once.  the table is shared by the
+// threads without locking.
+void SetPerftTable(int megabytes);
+
+#endif
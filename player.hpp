@@ -33,6 +33,7 @@ class PLAYER
 
   public:
     PLAYER(PIECECOLOR c) : color(c) { }
+    virtual ~PLAYER(void) { }
 
     PIECECOLOR whatColor(void) const { return(color); }
 
@@ -0,0 +1,996 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "misc.hpp"
+#include "brdsize.hpp"
+#include "chess.hpp"
+#include "tbase.hpp"
+
+extern void OutOfMemory(void);
+
+// the value of a position in a tablebase is 0 for a draw, TBILLEGAL
+// for a position that cannot happen, and otherwise 1 plus the number
+// of plies until mate.  the player to move wins if the number of
+// plies is odd, and is mated if it is even.
+const unsigned char TBILLEGAL = 255;
+const int TBMAXPLIES = 253;
+
+// a square is numbered as a BITBOARD position:  the file times 8
+// plus the rank.  the file of the white king is kept in the a - d
+// half of the board, by mirroring the board left to right, so a
+// tablebase has 2 * 32 * 64 ... entries.
+
+// a position of an endgame, as the colors, types and squares of its
+// pieces
+class TBPOSITION
+  {
+  public:
+    int nPieces;
+    PIECECOLOR color[MAXTBPIECES];
+    PIECETYPE type[MAXTBPIECES];
+    int square[MAXTBPIECES];
+
+    // remove a (captured) piece
+    void remove(int i)
+      {
+        nPieces--;
+        for ( ; i < nPieces; i++)
+          {
+            color[i] = color[i + 1];
+            type[i] = type[i + 1];
+            square[i] = square[i + 1];
+          }
+      }
+
+    BITBOARD occupied(void) const
+      {
+        BITBOARD o = 0;
+        int i;
+
+        for (i = 0; i < nPieces; i++)
+          o |= ((BITBOARD) 1) << square[i];
+
+        return(o);
+      }
+  };
+
+// letters of the piece types, in the order of PIECETYPE
+LOCAL const char typeLetter[] = "KQBNRP";
+
+// order of the piece types (in the order of PIECETYPE) in the name of
+// an endgame:  K, Q, R, B, N, P
+LOCAL const int typeOrder[] = { 0, 1, 3, 4, 2, 5 };
+
+// order of a piece in a position of a tablebase:  the white king, the
+// black king, the other white pieces, then the other black pieces
+LOCAL inline int pieceOrder(PIECECOLOR color, PIECETYPE type)
+  {
+    if (type == TYPEKING)
+      return(color);
+
+    return(2 + (color * 8) + typeOrder[type]);
+  }
+
+// put the pieces of a position in the order of a tablebase
+LOCAL void sortPieces(TBPOSITION &p)
+  {
+    int i, j, s;
+    PIECECOLOR c;
+    PIECETYPE t;
+
+    for (i = 1; i < p.nPieces; i++)
+      for (j = i; (j > 0) && (pieceOrder(p.color[j], p.type[j]) <
+                               pieceOrder(p.color[j - 1], p.type[j - 1]));
+           j--)
+        {
+          c = p.color[j];
+          p.color[j] = p.color[j - 1];
+          p.color[j - 1] = c;
+          t = p.type[j];
+          p.type[j] = p.type[j - 1];
+          p.type[j - 1] = t;
+          s = p.square[j];
+          p.square[j] = p.square[j - 1];
+          p.square[j - 1] = s;
+        }
+
+    return;
+  }
+
+// writes the name of the endgame of a sorted position.  name must
+// have room for MAXTBPIECES + 1 characters.
+LOCAL void endgameName(const TBPOSITION &p, char *name)
+  {
+    int i;
+
+    *name++ = 'K';
+    for (i = 2; (i < p.nPieces) && (p.color[i] == WHITE); i++)
+      *name++ = typeLetter[p.type[i]];
+    *name++ = 'K';
+    for ( ; i < p.nPieces; i++)
+      *name++ = typeLetter[p.type[i]];
+    *name = '\0';
+
+    return;
+  }
+
+// returns TRUE if the tablebase for the endgame of a sorted position
+// is the one for it, and FALSE if it is the one for the endgame with
+// the colors reversed.  the side with more pieces, or with the
+// stronger pieces, is white.
+LOCAL BOOL isCanonical(const TBPOSITION &p)
+  {
+    int nWhite = 0, nBlack, i;
+
+    while (((nWhite + 2) < p.nPieces) && (p.color[nWhite + 2] == WHITE))
+      nWhite++;
+    nBlack = p.nPieces - 2 - nWhite;
+
+    if (nWhite != nBlack)
+      return(nWhite > nBlack);
+
+    for (i = 0; i < nWhite; i++)
+      if (p.type[2 + i] != p.type[2 + nWhite + i])
+        return(typeOrder[p.type[2 + i]] < typeOrder[p.type[2 + nWhite + i]]);
+
+    return(TRUE);
+  }
+
+// reverse the colors of a position, mirroring it top to bottom, and
+// sort it again
+LOCAL void reverseColors(TBPOSITION &p, PIECECOLOR &toMove)
+  {
+    int i;
+
+    for (i = 0; i < p.nPieces; i++)
+      {
+        p.color[i] = OtherColor(p.color[i]);
+        p.square[i] ^= 7;
+      }
+    toMove = OtherColor(toMove);
+
+    sortPieces(p);
+
+    return;
+  }
+
+LOCAL long tableSize(int nPieces)
+  {
+    long size = 2 * 32;
+
+    while (--nPieces > 0)
+      size *= 64;
+
+    return(size);
+  }
+
+// index in its tablebase of a sorted position
+LOCAL long tableIndex(const TBPOSITION &p, PIECECOLOR toMove)
+  {
+    // mirror the board left to right if the white king is on the e - h
+    // files
+    int flip = (p.square[0] >> 3) > 3 ? 56 : 0;
+    long index = (toMove * 32) + (p.square[0] ^ flip);
+    int i;
+
+    for (i = 1; i < p.nPieces; i++)
+      index = (index * 64) + (p.square[i] ^ flip);
+
+    return(index);
+  }
+
+// sets the squares of a position and the color to move from its index
+// in its tablebase
+LOCAL void indexPosition(long index, TBPOSITION &p, PIECECOLOR &toMove)
+  {
+    int i;
+
+    for (i = p.nPieces - 1; i > 0; i--)
+      {
+        p.square[i] = (int) (index & 63);
+        index >>= 6;
+      }
+    p.square[0] = (int) (index & 31);
+    toMove = (PIECECOLOR) (index >> 5);
+
+    return;
+  }
+
+LOCAL inline int sign(int n)
+  { return((n > 0) - (n < 0)); }
+
+// returns TRUE if a piece on the from square attacks the to square,
+// with the given squares occupied
+LOCAL BOOL attacks
+  (
+    PIECETYPE type,
+    PIECECOLOR color,
+    int from,
+    int to,
+    BITBOARD occupied
+  )
+  {
+    int df = (to >> 3) - (from >> 3), dr = (to & 7) - (from & 7);
+    int adf = df < 0 ? -df : df, adr = dr < 0 ? -dr : dr;
+    int step, s;
+
+    switch (type)
+      {
+      case TYPEKING:
+        return((adf <= 1) && (adr <= 1) && (adf || adr));
+
+      case TYPEKNIGHT:
+        return((adf * adr) == 2);
+
+      case TYPEPAWN:
+        return((adf == 1) && (dr == (color == WHITE ? 1 : -1)));
+
+      case TYPEROOK:
+        if (df && dr)
+          return(FALSE);
+        break;
+
+      case TYPEBISHOP:
+        if (adf != adr)
+          return(FALSE);
+        break;
+
+      case TYPEQUEEN:
+        if (df && dr && (adf != adr))
+          return(FALSE);
+        break;
+
+      default:
+        return(FALSE);
+      }
+
+    if (!df && !dr)
+      return(FALSE);
+
+    step = (sign(df) * 8) + sign(dr);
+    for (s = from + step; s != to; s += step)
+      if (occupied & (((BITBOARD) 1) << s))
+        return(FALSE);
+
+    return(TRUE);
+  }
+
+// returns TRUE if the king of the given color is attacked
+LOCAL BOOL inCheck(const TBPOSITION &p, PIECECOLOR color)
+  {
+    BITBOARD occupied = p.occupied();
+    int king, i;
+
+    for (king = 0; p.type[king] != TYPEKING || p.color[king] != color;
+         king++)
+      ;
+
+    for (i = 0; i < p.nPieces; i++)
+      if ((p.color[i] != color) &&
+          attacks(p.type[i], p.color[i], p.square[i], p.square[king],
+                  occupied))
+        return(TRUE);
+
+    return(FALSE);
+  }
+
+// returns TRUE if the position can happen with the given color to
+// move
+LOCAL BOOL isLegal(const TBPOSITION &p, PIECECOLOR toMove)
+  {
+    int i, j;
+
+    for (i = 0; i < p.nPieces; i++)
+      {
+        if ((p.type[i] == TYPEPAWN) &&
+            (((p.square[i] & 7) == 0) || ((p.square[i] & 7) == 7)))
+          return(FALSE);
+        for (j = 0; j < i; j++)
+          if (p.square[i] == p.square[j])
+            return(FALSE);
+      }
+
+    return(!inCheck(p, OtherColor(toMove)));
+  }
+
+// most moves from a position of a tablebase, counting each promotion
+const int MAXTBMOVES = 128;
+
+// directions of the moves of the pieces, as changes in square number
+LOCAL const int kingStep[] = { -9, -8, -7, -1, 1, 7, 8, 9 };
+LOCAL const int knightStep[] = { -17, -15, -10, -6, 6, 10, 15, 17 };
+
+// returns TRUE if a step of a king, knight, rook or bishop from the
+// square stays on the board
+LOCAL inline BOOL stepOnBoard(int from, int to)
+  {
+    int df = (to >> 3) - (from >> 3), dr = (to & 7) - (from & 7);
+
+    return((to >= 0) && (to < 64) && (df >= -2) && (df <= 2) &&
+           (dr >= -2) && (dr <= 2));
+  }
+
+// returns TRUE if a direction of kingStep is along a rank or file
+LOCAL inline BOOL isOrthogonal(int d)
+  {
+    return((kingStep[d] == -8) || (kingStep[d] == -1) ||
+           (kingStep[d] == 1) || (kingStep[d] == 8));
+  }
+
+// lists the squares a king, knight, rook, bishop or queen on the from
+// square can move to (or have come from), up to and including the
+// first occupied square in each direction
+LOCAL int pieceTargets
+  (
+    PIECETYPE type,
+    int from,
+    BITBOARD occupied,
+    int *target
+  )
+  {
+    int n = 0, d, s;
+
+    for (d = 0; d < 8; d++)
+      switch (type)
+        {
+        case TYPEKING:
+          if (stepOnBoard(from, from + kingStep[d]))
+            target[n++] = from + kingStep[d];
+          break;
+
+        case TYPEKNIGHT:
+          if (stepOnBoard(from, from + knightStep[d]))
+            target[n++] = from + knightStep[d];
+          break;
+
+        default:
+          if (((type == TYPEROOK) && !isOrthogonal(d)) ||
+              ((type == TYPEBISHOP) && isOrthogonal(d)))
+            break;
+          for (s = from; stepOnBoard(s, s + kingStep[d]); )
+            {
+              s += kingStep[d];
+              target[n++] = s;
+              if (occupied & (((BITBOARD) 1) << s))
+                break;
+            }
+          break;
+        }
+
+    return(n);
+  }
+
+// lists the positions reached by the legal moves of the color to
+// move, each promotion to each type being a move.  the pieces stay in
+// the same order, less any piece captured.  returns the number of
+// moves.
+LOCAL int listTbMoves
+  (
+    const TBPOSITION &p,
+    PIECECOLOR toMove,
+    TBPOSITION *after
+  )
+  {
+    LOCAL const PIECETYPE promoteType[] =
+      { TYPEQUEEN, TYPEROOK, TYPEBISHOP, TYPEKNIGHT };
+    BITBOARD occupied = p.occupied();
+    int target[32], nTargets, i, j, t, k, n = 0;
+    int forward = toMove == WHITE ? 1 : -1;
+    int to, captured, nPromote;
+
+    for (i = 0; i < p.nPieces; i++)
+      {
+        if (p.color[i] != toMove)
+          continue;
+
+        if (p.type[i] == TYPEPAWN)
+          {
+            nTargets = 0;
+            to = p.square[i] + forward;
+            if (!(occupied & (((BITBOARD) 1) << to)))
+              {
+                target[nTargets++] = to;
+                if (((p.square[i] & 7) == (toMove == WHITE ? 1 : 6)) &&
+                    !(occupied & (((BITBOARD) 1) << (to + forward))))
+                  target[nTargets++] = to + forward;
+              }
+            // captures, one file to either side
+            for (k = -8; k <= 8; k += 16)
+              {
+                to = p.square[i] + forward + k;
+                if ((to >= 0) && (to < 64) &&
+                    (occupied & (((BITBOARD) 1) << to)))
+                  target[nTargets++] = to;
+              }
+          }
+        else
+          nTargets = pieceTargets(p.type[i], p.square[i], occupied, target);
+
+        for (t = 0; t < nTargets; t++)
+          {
+            to = target[t];
+
+            captured = -1;
+            for (j = 0; j < p.nPieces; j++)
+              if ((j != i) && (p.square[j] == to))
+                captured = j;
+            if ((captured >= 0) && ((p.color[captured] == toMove) ||
+                                    (p.type[captured] == TYPEKING)))
+              continue;
+
+            nPromote = 1;
+            if ((p.type[i] == TYPEPAWN) && (((to & 7) == 0) ||
+                                            ((to & 7) == 7)))
+              nPromote = 4;
+
+            for (k = 0; k < nPromote; k++)
+              {
+                after[n] = p;
+                after[n].square[i] = to;
+                if (nPromote > 1)
+                  after[n].type[i] = promoteType[k];
+                if (captured >= 0)
+                  after[n].remove(captured);
+
+                // the move is the same for every promotion
+                if (inCheck(after[n], toMove))
+                  break;
+
+                n++;
+              }
+          }
+      }
+
+    return(n);
+  }
+
+// lists the positions from which the color that just moved could have
+// made a move to the position, other than a capture or promotion.
+// the positions listed are not checked to be legal.
+LOCAL int listTbUnmoves
+  (
+    const TBPOSITION &p,
+    PIECECOLOR mover,
+    TBPOSITION *before
+  )
+  {
+    BITBOARD occupied = p.occupied();
+    int target[32], nTargets, i, t, n = 0;
+    int back = mover == WHITE ? -1 : 1;
+    int from, rank;
+
+    for (i = 0; i < p.nPieces; i++)
+      {
+        if (p.color[i] != mover)
+          continue;
+
+        if (p.type[i] == TYPEPAWN)
+          {
+            // rank of the pawn counted from its own side
+            rank = mover == WHITE ? (p.square[i] & 7) :
+                                    (7 - (p.square[i] & 7));
+            from = p.square[i] + back;
+            if ((rank < 2) || (occupied & (((BITBOARD) 1) << from)))
+              continue;
+
+            before[n] = p;
+            before[n++].square[i] = from;
+
+            if ((rank == 3) &&
+                !(occupied & (((BITBOARD) 1) << (from + back))))
+              {
+                before[n] = p;
+                before[n++].square[i] = from + back;
+              }
+          }
+        else
+          {
+            nTargets = pieceTargets(p.type[i], p.square[i], occupied,
+                                    target);
+            for (t = 0; t < nTargets; t++)
+              if (!(occupied & (((BITBOARD) 1) << target[t])))
+                {
+                  before[n] = p;
+                  before[n++].square[i] = target[t];
+                }
+          }
+      }
+
+    return(n);
+  }
+
+// the most tablebases used at once
+const int MAXTABLEBASES = 64;
+
+// a tablebase in memory (mapped from its file, or made by
+// MakeTablebase)
+class TABLEBASE
+  {
+  public:
+    char name[MAXTBPIECES + 1];
+    // null if there is no tablebase
+    const unsigned char *value;
+  };
+
+LOCAL TABLEBASE tablebase[MAXTABLEBASES];
+LOCAL int nTablebases;
+
+// directory of the tablebase files, null (using none) until one is given
+LOCAL const char *tablebaseDir = (const char *) 0;
+
+void SetTablebaseDir(const char *dir)
+  {
+    tablebaseDir = dir;
+
+    return;
+  }
+
+// writes the name of the file of a tablebase.  path must have room
+// for FILENAME_MAX characters.
+LOCAL void tablebasePath(const char *name, char *path)
+  {
+    snprintf(path, FILENAME_MAX, "%s/%s.tb", tablebaseDir, name);
+
+    return;
+  }
+
+// maps the file of a tablebase into memory, returns null if there is
+// no valid file
+LOCAL const unsigned char *mapTablebase(const char *name, int nPieces)
+  {
+    char path[FILENAME_MAX];
+    struct stat st;
+    void *mapped;
+    int fd;
+
+    tablebasePath(name, path);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+      return((const unsigned char *) 0);
+
+    if (fstat(fd, &st) || (st.st_size != tableSize(nPieces)))
+      {
+        close(fd);
+        return((const unsigned char *) 0);
+      }
+
+    mapped = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+      return((const unsigned char *) 0);
+
+    return((const unsigned char *) mapped);
+  }
+
+LOCAL const unsigned char *makeTable(const TBPOSITION &endgame,
+                                     const char *name);
+
+// returns the tablebase for the endgame of a sorted position (which
+// must be the one isCanonical is TRUE for), or null if there is none.
+// if make is TRUE, a tablebase that has no file is made.
+LOCAL const unsigned char *findTable(const TBPOSITION &endgame, BOOL make)
+  {
+    char name[MAXTBPIECES + 1];
+    int t;
+
+    endgameName(endgame, name);
+
+    for (t = 0; t < nTablebases; t++)
+      if (strcmp(tablebase[t].name, name) == 0)
+        break;
+
+    if (t == nTablebases)
+      {
+        if (nTablebases == MAXTABLEBASES)
+          return((const unsigned char *) 0);
+        nTablebases++;
+        strcpy(tablebase[t].name, name);
+        tablebase[t].value = mapTablebase(name, endgame.nPieces);
+      }
+
+    if (!tablebase[t].value && make)
+      tablebase[t].value = makeTable(endgame, name);
+
+    return(tablebase[t].value);
+  }
+
+// returns the value of a position in its tablebase, or -1 if there
+// is no tablebase for it.  if make is TRUE, a tablebase that has no
+// file is made.
+LOCAL int probe(TBPOSITION p, PIECECOLOR toMove, BOOL make)
+  {
+    const unsigned char *value;
+
+    // two kings alone is a draw
+    if (p.nPieces == 2)
+      return(0);
+
+    sortPieces(p);
+    if (!isCanonical(p))
+      reverseColors(p, toMove);
+
+    value = findTable(p, make);
+    if (!value)
+      return(-1);
+
+    return(value[tableIndex(p, toMove)]);
+  }
+
+// makes the tablebase for the endgame of a sorted position by
+// retrograde analysis, and writes it to its file.  returns null if it
+// cannot be made.
+LOCAL const unsigned char *makeTable(const TBPOSITION &endgame,
+                                     const char *name)
+  {
+    long size = tableSize(endgame.nPieces), index, r;
+    unsigned char *value, *count, *outLoss;
+    TBPOSITION p = endgame, moves[MAXTBMOVES];
+    PIECECOLOR toMove;
+    int nMoves, m, i, v, ply, win, level, maxLevel = 0;
+    long nWins = 0, nLosses = 0, nDraws = 0;
+    char path[FILENAME_MAX];
+    BOOL sameEndgame;
+    FILE *f;
+
+    // value is as in the file.  for a position not yet known to be won
+    // or lost, count is the number of its moves that are not yet known
+    // to lose, and outLoss is the longest mate (in plies) by the moves
+    // that leave the endgame (by a capture or promotion) and lose.
+    if (!(value = new unsigned char[size]) ||
+        !(count = new unsigned char[size]) ||
+        !(outLoss = new unsigned char[size]))
+      OutOfMemory();
+
+    printf("making %s\n", name);
+    fflush(stdout);
+
+    // find the positions that are mate, or are won or lost by leaving
+    // the endgame, and count the moves of the others
+    for (index = 0; index < size; index++)
+      {
+        indexPosition(index, p, toMove);
+        value[index] = 0;
+        count[index] = 0;
+        outLoss[index] = 0;
+
+        if (!isLegal(p, toMove))
+          {
+            value[index] = TBILLEGAL;
+            continue;
+          }
+
+        nMoves = listTbMoves(p, toMove, moves);
+        if (nMoves == 0)
+          {
+            // checkmate (or stalemate, a draw)
+            if (inCheck(p, toMove))
+              value[index] = 1;
+            continue;
+          }
+
+        win = 0;
+        for (m = 0; m < nMoves; m++)
+          {
+            sameEndgame = moves[m].nPieces == p.nPieces;
+            for (i = 0; sameEndgame && (i < p.nPieces); i++)
+              sameEndgame = moves[m].type[i] == p.type[i];
+
+            if (sameEndgame)
+              {
+                count[index]++;
+                continue;
+              }
+
+            v = probe(moves[m], OtherColor(toMove), TRUE);
+            if (v < 0)
+              {
+                delete [] value;
+                delete [] count;
+                delete [] outLoss;
+                return((const unsigned char *) 0);
+              }
+
+            if (v == 0)
+              // a draw, so the position is not lost.  it is counted as
+              // a move never known to lose.
+              count[index]++;
+            else if (((v - 1) & 1) == 0)
+              {
+                // the opponent is mated
+                if (!win || (v < win))
+                  win = v;
+              }
+            else if (v > outLoss[index])
+              outLoss[index] = (unsigned char) v;
+          }
+
+        if (win)
+          value[index] = (unsigned char) (win + 1);
+        else if (count[index] == 0)
+          value[index] = (unsigned char) (outLoss[index] + 1);
+        else
+          continue;
+
+        if ((value[index] - 1) > maxLevel)
+          maxLevel = value[index] - 1;
+      }
+
+    // go back from the positions mated in each number of plies in turn
+    // to the positions before them
+    for (level = 0; level <= maxLevel; level++)
+      for (index = 0; index < size; index++)
+        {
+          if (value[index] != (level + 1))
+            continue;
+
+          indexPosition(index, p, toMove);
+          nMoves = listTbUnmoves(p, OtherColor(toMove), moves);
+
+          for (m = 0; m < nMoves; m++)
+            {
+              r = tableIndex(moves[m], OtherColor(toMove));
+              if (value[r] == TBILLEGAL)
+                continue;
+
+              if ((level & 1) == 0)
+                {
+                  // the player to move is mated, so the move to the
+                  // position wins
+                  if ((level < TBMAXPLIES) &&
+                      ((value[r] == 0) || (value[r] > (level + 2))))
+                    {
+                      value[r] = (unsigned char) (level + 2);
+                      if ((level + 1) > maxLevel)
+                        maxLevel = level + 1;
+                    }
+                }
+              else if ((value[r] == 0) && (count[r] > 0))
+                // the move to the position loses.  if all the moves
+                // lose, the position is lost.
+                if (--count[r] == 0)
+                  {
+                    ply = outLoss[r] > (level + 1) ? outLoss[r] :
+                                                     (level + 1);
+                    if (ply <= TBMAXPLIES)
+                      {
+                        value[r] = (unsigned char) (ply + 1);
+                        if (ply > maxLevel)
+                          maxLevel = ply;
+                      }
+                  }
+            }
+        }
+
+    delete [] count;
+    delete [] outLoss;
+
+    for (index = 0; index < size; index++)
+      if (value[index] == 0)
+        nDraws++;
+      else if (value[index] != TBILLEGAL)
+        {
+          if ((value[index] - 1) & 1)
+            nWins++;
+          else
+            nLosses++;
+        }
+
+    printf("%s:  %ld won, %ld lost, %ld drawn, longest mate %d plies\n",
+           name, nWins, nLosses, nDraws, maxLevel);
+
+    tablebasePath(name, path);
+    f = fopen(path, "wb");
+    if (!f || (fwrite(value, 1, size, f) != (size_t) size) || fclose(f))
+      {
+        fprintf(stderr, "Cannot write %s\n", path);
+        delete [] value;
+        return((const unsigned char *) 0);
+      }
+
+    return(value);
+  }
+
+// returns TRUE if a king and rook of the given color have not moved,
+// so that it might castle.  tablebases leave out castling.
+LOCAL BOOL mightCastle(const BOARD &board, PIECECOLOR color)
+  {
+    int backCol = color == WHITE ? 0 : (NUMCOLS - 1);
+    PIECE *king = board.whatPiece(POSITION(4, backCol)), *rook;
+    int rookRow;
+
+    if (!king || (king->whatType() != TYPEKING) || king->hasBeenMoved())
+      return(FALSE);
+
+    for (rookRow = 0; rookRow < NUMROWS; rookRow += NUMROWS - 1)
+      {
+        rook = board.whatPiece(POSITION(rookRow, backCol));
+        if (rook && (rook->whatColor() == color) &&
+            (rook->whatType() == TYPEROOK) && !rook->hasBeenMoved())
+          return(TRUE);
+      }
+
+    return(FALSE);
+  }
+
+// returns TRUE if a pawn of either color could still make a double
+// move while the other color has a pawn, so that an en passant capture
+// might be possible, now or later.  tablebases leave out en passant
+// captures, so their results for such positions may be wrong.  a pawn
+// that has left its first rank can never make a double move again.
+LOCAL BOOL mightCaptureEnPassant(const BOARD &board)
+  {
+    // the positions of the second and seventh ranks
+    const BITBOARD secondRank = 0x0202020202020202ULL;
+    const BITBOARD seventhRank = 0x4040404040404040ULL;
+    BITBOARD whitePawns = board.whatPieces(WHITE, TYPEPAWN);
+    BITBOARD blackPawns = board.whatPieces(BLACK, TYPEPAWN);
+
+    return(((whitePawns & secondRank) && blackPawns) ||
+           ((blackPawns & seventhRank) && whitePawns));
+  }
+
+BOOL TablebaseMove
+  (
+    const BOARD &board,
+    PIECECOLOR color,
+    PIECEMOVE &move,
+    int &plies
+  )
+  {
+    BITBOARD pieces = board.whatPieces(WHITE) | board.whatPieces(BLACK);
+    TBPOSITION p, after;
+    MOVELIST moves;
+    PIECE *piece;
+    int m, i = 0, j, nMoves, captured, v, score, bestScore = 0;
+    int bestMove = -1;
+
+    if (!tablebaseDir || (CountPositions(pieces) > MAXTBPIECES) ||
+        mightCastle(board, WHITE) || mightCastle(board, BLACK) ||
+        mightCaptureEnPassant(board))
+      return(FALSE);
+
+    p.nPieces = 0;
+    for ( ; pieces; pieces = RemoveFirst(pieces))
+      {
+        piece = board.whatPiece(FirstPosition(pieces));
+        p.color[p.nPieces] = piece->whatColor();
+        p.type[p.nPieces] = piece->whatType();
+        p.square[p.nPieces++] = PositionIndex(FirstPosition(pieces));
+      }
+
+    // every promotion is tried, not only the ones the look-ahead tries
+    board.listMoves(color, moves, FALSE);
+    nMoves = moves.nMoves;
+    for (m = 0; m < nMoves; m++)
+      if ((moves.move[m].type == NORMALMOVE) &&
+          (moves.move[m].promoteType == TYPEQUEEN))
+        {
+          moves.move[moves.nMoves] = moves.move[m];
+          moves.move[moves.nMoves++].promoteType = TYPEROOK;
+          moves.move[moves.nMoves] = moves.move[m];
+          moves.move[moves.nMoves++].promoteType = TYPEBISHOP;
+        }
+
+    for (m = 0; m < moves.nMoves; m++)
+      {
+        const PIECEMOVE &pm = moves.move[m];
+
+        after = p;
+        captured = -1;
+        for (j = 0; j < p.nPieces; j++)
+          {
+            if (p.square[j] == PositionIndex(pm.start))
+              i = j;
+            if (p.square[j] == PositionIndex(pm.end))
+              captured = j;
+          }
+        if ((captured < 0) && (p.type[i] == TYPEPAWN) &&
+            (pm.start.row != pm.end.row))
+          // en passant
+          for (j = 0; j < p.nPieces; j++)
+            if (p.square[j] ==
+                PositionIndex(POSITION(pm.end.row, pm.start.col)))
+              captured = j;
+
+        after.square[i] = PositionIndex(pm.end);
+        if (pm.promoteType != TYPENOPIECE)
+          after.type[i] = pm.promoteType;
+        if (captured >= 0)
+          after.remove(captured);
+
+        v = probe(after, OtherColor(color), FALSE);
+        if ((v < 0) || (v == TBILLEGAL))
+          return(FALSE);
+
+        // v - 1 is the number of plies until mate after the move, so
+        // v is the number from the position
+        if (v == 0)
+          score = 0;
+        else if (((v - 1) & 1) == 0)
+          // the opponent is mated, the sooner the better
+          score = 1000 - v;
+        else
+          // the player is mated, the later the better
+          score = v - 1000;
+
+        if ((bestMove < 0) || (score > bestScore))
+          {
+            bestMove = m;
+            bestScore = score;
+          }
+      }
+
+    if (bestMove < 0)
+      return(FALSE);
+
+    move = moves.move[bestMove];
+    plies = bestScore > 0 ? 1000 - bestScore :
+            bestScore < 0 ? -(bestScore + 1000) : 0;
+
+    return(TRUE);
+  }
+
+BOOL MakeTablebase(const char *name)
+  {
+    TBPOSITION endgame;
+    PIECECOLOR color = BLACK, toMove = WHITE;
+    const char *letter;
+    int i;
+
+    endgame.nPieces = 0;
+    for (i = 0; name[i]; i++)
+      {
+        letter = strchr(typeLetter, toupper(name[i]));
+        if (!letter || (endgame.nPieces == MAXTBPIECES))
+          break;
+        if (*letter == 'K')
+          {
+            if (color == BLACK && i > 0)
+              break;
+            color = OtherColor(color);
+          }
+        else if (i == 0)
+          break;
+        endgame.color[endgame.nPieces] = color;
+        endgame.type[endgame.nPieces] = (PIECETYPE) (letter - typeLetter);
+        endgame.square[endgame.nPieces++] = 0;
+      }
+
+    if (name[i] || (color != BLACK) || (endgame.nPieces < 3))
+      {
+        fprintf(stderr, "Invalid endgame %s\n", name);
+        return(FALSE);
+      }
+
+    sortPieces(endgame);
+    if (!isCanonical(endgame))
+      reverseColors(endgame, toMove);
+
+    return(findTable(endgame, TRUE) != (const unsigned char *) 0);
+  }
@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#if !defined(TBASE_HPP)
+#define TBASE_HPP
+
+#include "misc.hpp"
+#include "chess.hpp"
+
+// most pieces (including the kings) in an endgame with a tablebase
+const int MAXTBPIECES = 4;
+
+// a tablebase gives the result, with best play, of every position of
+// an endgame with a given set of pieces:  a draw, or mate in a given
+// number of plies (moves by either player).  an endgame is named by
+// the white pieces then the black pieces, each starting with the
+// king, for example "KQKR".  a tablebase is in a file of the same
+// name, with ".tb" added, of 1 byte for each position.
+
+// sets the directory holding the tablebase files used by
+// TablebaseMove.  until it is set, no tablebases are used.
+void SetTablebaseDir(const char *dir);
+
+// if there are tablebases for the position on the board (with the
+// given color to move) and all the positions reached by its moves,
+// returns TRUE with the best move in move.  plies is set to the
+// number of plies until mate, positive if the color to move wins and
+// negative if it loses, or 0 if the position is drawn.  returns FALSE
+// while a king might still castle, or while a pawn might still make a
+// double move that could be captured en passant, since the tablebases
+// leave out those moves.
+BOOL TablebaseMove
+  (
+    const BOARD &board,
+    PIECECOLOR color,
+    PIECEMOVE &move,
+    int &plies
+  );
+
+// makes the tablebase for the named endgame, and the ones for the
+// endgames reached from it by captures and promotions, by retrograde
+// analysis, writing any that are not already there to files in the
+// directory given by SetTablebaseDir.  returns FALSE (after printing
+// a message) if the name is not valid or a file cannot be written.
+BOOL MakeTablebase(const char *name);
+
+#endif
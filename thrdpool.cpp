@@ -0,0 +1,152 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#include "misc.hpp"
+#include "thrdpool.hpp"
+
+THREADPOOL SearchThreads;
+
+class THREADPOOL::IMPL
+  {
+  public:
+    std::vector<std::thread> thread;
+    std::mutex mutex;
+    // signalled when there is a new job, or the threads should exit
+    std::condition_variable start;
+    // signalled when a thread finishes the job
+    std::condition_variable done;
+
+    // the current job
+    THREADJOB job;
+    void *arg;
+    // incremented for each new job
+    unsigned jobNumber;
+    // number of threads (other than the calling one) still running
+    // the current job
+    int nRunning;
+    // set when the threads should exit
+    BOOL quit;
+
+    IMPL(void) : jobNumber(0), nRunning(0), quit(FALSE) { }
+
+    // body of each thread in the pool.  lastJob is the number of the
+    // last job run before the thread was created.
+    void waitForJobs(int threadNumber, unsigned lastJob);
+
+    void stopThreads(void);
+  };
+
+void THREADPOOL::IMPL::waitForJobs(int threadNumber, unsigned lastJob)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for ( ; ; )
+      {
+        while (!quit && (jobNumber == lastJob))
+          start.wait(lock);
+
+        if (quit)
+          return;
+
+        lastJob = jobNumber;
+
+        lock.unlock();
+        job(arg, threadNumber);
+        lock.lock();
+
+        if (--nRunning == 0)
+          done.notify_one();
+      }
+  }
+
+void THREADPOOL::IMPL::stopThreads(void)
+  {
+    unsigned t;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = TRUE;
+    }
+    start.notify_all();
+
+    for (t = 0; t < thread.size(); t++)
+      thread[t].join();
+
+    thread.clear();
+    quit = FALSE;
+
+    return;
+  }
+
+THREADPOOL::THREADPOOL(void) : impl(new IMPL) { }
+
+THREADPOOL::~THREADPOOL(void)
+  {
+    impl->stopThreads();
+    delete impl;
+  }
+
+void THREADPOOL::setThreads(int nThreads)
+  {
+    int t;
+
+    impl->stopThreads();
+
+    for (t = 1; t < nThreads; t++)
+      impl->thread.push_back
+        (std::thread(&IMPL::waitForJobs, impl, t, impl->jobNumber));
+
+    return;
+  }
+
+int THREADPOOL::howManyThreads(void) const
+  {
+    return(impl->thread.size() + 1);
+  }
+
+void THREADPOOL::run(THREADJOB job, void *arg)
+  {
+    if (impl->thread.empty())
+      {
+        job(arg, 0);
+        return;
+      }
+
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      impl->job = job;
+      impl->arg = arg;
+      impl->nRunning = impl->thread.size();
+      impl->jobNumber++;
+    }
+    impl->start.notify_all();
+
+    job(arg, 0);
+
+    std::unique_lock<std::mutex> lock(impl->mutex);
+    while (impl->nRunning)
+      impl->done.wait(lock);
+
+    return;
+  }
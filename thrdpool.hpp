@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#if !defined(THRDPOOL_HPP)
+#define THRDPOOL_HPP
+
+#include "misc.hpp"
+
+// the most threads a pool may have
+const int MAXTHREADS = 64;
+
+// function run by each thread for a job.  arg is as passed to
+// THREADPOOL::run, thread is the number of the thread running it
+// (0 is the thread that called run).
+typedef void (*THREADJOB)(void *arg, int thread);
+
+// a fixed set of threads that wait to be given jobs, so that threads
+// are not created and destroyed for each job
+class THREADPOOL
+  {
+  public:
+    // the pool starts out with only the calling thread
+    THREADPOOL(void);
+    ~THREADPOOL(void);
+
+    // change the number of threads (including the calling thread) that
+    // run each job
+    void setThreads(int nThreads);
+
+    int howManyThreads(void) const;
+
+    // run the job in each of the threads, and wait for all to finish.
+    void run(THREADJOB job, void *arg);
+
+  private:
+    // implementation details are hidden in thrdpool.cpp
+    class IMPL;
+    IMPL *impl;
+
+    THREADPOOL(const THREADPOOL &);
+    THREADPOOL & operator = (const THREADPOOL &);
+  };
+
+// the pool used by the look-ahead search
+extern THREADPOOL SearchThreads;
+
+#endif
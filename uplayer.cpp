@@ -23,10 +23,7 @@ SOFTWARE.
 
 GAMESTATUS USERPLAYER::play(BOARD &board) const
   {
-    BOARDMETRIC metric;
-
-    board.findBestMoves(2, whatColor(), metric, (BESTMOVES *) 0);
-    switch (metric.kingSituation[whatColor()])
+    switch (board.kingSituation(whatColor()))
       {
       case KINGLOST:
         ChessUI.mated(whatColor());